@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+"""Builds a config record flash image for RE_SWC on the host.
+
+The image covers the whole config store ring (8 pages of 256 bytes from
+0x0800E800). Page 0 holds the record, the rest are left erased, so writing the
+image replaces whatever the unit had stored. See "Configuration Storage" in
+README.md.
+
+    python3 config_record.py --set headunit_brand=KENWOOD \\
+        --set timing_profile_brand=KENWOOD --set timing_profile.gap_ms=10 \\
+        -o config.bin
+
+--from takes a dump of the ring read back from a unit, its newest valid record
+is used as the starting point instead of the firmware defaults.
+"""
+import argparse
+import struct
+import sys
+import zlib
+
+# Must match config_store.hpp and Config_t in src/main.cpp
+FLASH_ADDRESS = 0x0800E800
+PAGE_SIZE = 256
+PAGE_COUNT = 8
+MAGIC = 0x31474643
+CONFIG_VERSION = 1
+HEADER = struct.Struct("<IIBBHI")  # magic, sequence, version, reserved, length, crc
+
+BRANDS = {
+    "GENERIC_RESISTIVE": 1,
+    "JVC": 2,
+    "KENWOOD": 3,
+    "ALPINE": 4,
+    "PIONEER": 5,
+    "USB_HID": 6,
+    "TESTING": 7,
+    "GENERIC_PULSE_DISTANCE": 8,
+    "NONE": 9,  # HEADUNIT_BRAND_ERROR, no timing profile
+}
+
+# Resistive_Function_t in resistive_table.hpp, one accepted_functions bit each
+RESISTIVE_FUNCTIONS = ["VOLUME_UP", "VOLUME_DOWN", "MUTE", "NEXT_TRACK", "PREVIOUS_TRACK"]
+RESISTIVE_ALL_FUNCTIONS = (1 << len(RESISTIVE_FUNCTIONS)) - 1
+assert RESISTIVE_ALL_FUNCTIONS == 0x1F, "Resistive functions no longer match"
+
+# Field name, struct format and firmware default, in record order
+FIELDS = [
+    ("headunit_brand", "B", BRANDS["GENERIC_RESISTIVE"]),
+    ("generic_pulse_distance.tick_us", "H", 530),
+    ("generic_pulse_distance.preamble_mark_us", "H", 9000),
+    ("generic_pulse_distance.preamble_space_us", "H", 4000),
+    ("generic_pulse_distance.bit_mark_ticks", "B", 1),
+    ("generic_pulse_distance.zero_space_ticks", "B", 1),
+    ("generic_pulse_distance.one_space_ticks", "B", 3),
+    ("generic_pulse_distance.address_length", "B", 2),
+    ("generic_pulse_distance.address", "2s", bytes([0xB9, 0x46])),
+    ("generic_pulse_distance.invert_command", "B", 1),
+    ("generic_pulse_distance.stop_mark_ticks", "B", 1),
+    ("generic_pulse_distance.gap_us", "H", 5000),
+    ("generic_pulse_distance.commands", "5s", bytes([0x14, 0x15, 0x16, 0x0B, 0x0A])),
+    ("hsi_trim_marker", "B", 0),
+    ("hsi_trim", "B", 0x10),
+    ("mcp4131_calibration.full_scale_ohms", "I", 100000),
+    ("mcp4131_calibration.wiper_ohms", "H", 75),
+    ("timing_profile_brand", "B", BRANDS["NONE"]),
+    ("timing_profile.hold_ms", "H", 0),
+    ("timing_profile.long_hold_ms", "H", 0),
+    ("timing_profile.gap_ms", "H", 0),
+    ("timing_profile.repeat_gap_ms", "H", 0),
+    ("timing_profile.rate_per_s", "B", 0),
+    ("timing_profile.burst", "B", 0),
+    ("accepted_functions", "B", RESISTIVE_ALL_FUNCTIONS),
+]
+RECORD = struct.Struct("<" + "".join(fmt for _, fmt, _ in FIELDS))
+assert RECORD.size == 0x2A, "Record no longer matches Config_t"
+
+
+def page_crc(header_fields, record):
+    # CRC-32 of the header up to the CRC itself, then the record
+    return zlib.crc32(HEADER.pack(*header_fields, 0)[:-4] + record)
+
+
+def parse_value(name, fmt, text):
+    if name.endswith("brand") and text.upper() in BRANDS:
+        return BRANDS[text.upper()]
+    if fmt.endswith("s"):
+        # Byte strings as hex, e.g. B946 or 14,15,16,0B,0A
+        value = bytes.fromhex(text.replace(",", " ").replace(":", " "))
+        if len(value) != int(fmt[:-1]):
+            sys.exit(f"{name} takes {fmt[:-1]} bytes")
+        return value
+    return int(text, 0)
+
+
+def newest_record(image):
+    """Sequence and fields of the newest valid record in a ring dump"""
+    best = None
+    for page in range(len(image) // PAGE_SIZE):
+        data = image[page * PAGE_SIZE : (page + 1) * PAGE_SIZE]
+        magic, sequence, version, reserved, length, crc = HEADER.unpack_from(data)
+        record = data[HEADER.size : HEADER.size + length]
+        if magic != MAGIC or length > PAGE_SIZE - HEADER.size:
+            continue
+        if page_crc((magic, sequence, version, reserved, length), record) != crc:
+            continue
+        if best is None or sequence > best[0]:
+            best = (sequence, version, record)
+    if best is None:
+        sys.exit("No valid record in the dump")
+    sequence, version, record = best
+    if version != CONFIG_VERSION:
+        print(f"Record is version {version}, converting to {CONFIG_VERSION}")
+    # Fields are only ever appended, take what the record has
+    defaults = RECORD.pack(*[default for _, _, default in FIELDS])
+    record = record[: RECORD.size] + defaults[len(record) :]
+    return sequence, list(RECORD.unpack(record))
+
+
+def build_image(values, sequence):
+    record = RECORD.pack(*values)
+    header_fields = (MAGIC, sequence, CONFIG_VERSION, 0, len(record))
+    page = HEADER.pack(*header_fields, page_crc(header_fields, record)) + record
+    page += b"\xff" * (PAGE_SIZE - len(page))
+    return page + b"\xff" * (PAGE_SIZE * (PAGE_COUNT - 1))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--from", dest="dump", help="ring dump to start from")
+    parser.add_argument(
+        "--set",
+        action="append",
+        default=[],
+        metavar="FIELD=VALUE",
+        help="field to change, brands by name or number",
+    )
+    parser.add_argument("--list", action="store_true", help="print the fields and exit")
+    parser.add_argument("-o", "--output", help="image to write")
+    args = parser.parse_args()
+
+    sequence = 0
+    values = [default for _, _, default in FIELDS]
+    if args.dump:
+        with open(args.dump, "rb") as f:
+            sequence, values = newest_record(f.read())
+
+    names = [name for name, _, _ in FIELDS]
+    for assignment in args.set:
+        name, _, text = assignment.partition("=")
+        if name not in names:
+            sys.exit(f"Unknown field {name}, see --list")
+        index = names.index(name)
+        values[index] = parse_value(name, FIELDS[index][1], text)
+
+    for (name, _, _), value in zip(FIELDS, values):
+        shown = value.hex() if isinstance(value, bytes) else value
+        print(f"{name} = {shown}")
+    if args.list or not args.output:
+        return
+
+    # One past the unit's newest record keeps the sequence counting commits
+    image = build_image(values, sequence + 1)
+    with open(args.output, "wb") as f:
+        f.write(image)
+    print(f"Wrote {args.output}, {len(image)} bytes for 0x{FLASH_ADDRESS:08X}")
+
+
+if __name__ == "__main__":
+    main()
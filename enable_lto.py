@@ -0,0 +1,9 @@
+Import("env")
+
+# Link-time optimisation for the single-brand images. Whole-program inlining
+# and dropping the unused drivers is where most of the savings come from
+print("Enabling link-time optimisation")
+env.Append(
+    CCFLAGS=["-flto"],
+    LINKFLAGS=["-flto", "-Wl,--gc-sections"],
+)
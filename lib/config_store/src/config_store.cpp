@@ -0,0 +1,158 @@
+#include "config_store.hpp"
+
+#define CONFIG_STORE_CRC_POLYNOMIAL 0xEDB88320 // CRC-32, reflected
+
+static uint32_t config_store_crc(const uint8_t *data, uint16_t length,
+                                 uint32_t crc) {
+  for (uint16_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ ((crc & 1) ? CONFIG_STORE_CRC_POLYNOMIAL : 0);
+    }
+  }
+  return crc;
+}
+
+/* Everything in the header after the CRC itself, then the record */
+static uint32_t config_store_page_crc(const Config_Store_Header_t *header,
+                                      const uint8_t                *record) {
+  uint32_t crc = config_store_crc((const uint8_t *)header,
+                                  offsetof(Config_Store_Header_t, crc),
+                                  0xFFFFFFFF);
+  return ~config_store_crc(record, header->length, crc);
+}
+
+void Config_Store::init_config_store(uint32_t flash_address,
+                                     uint8_t page_count, void *record,
+                                     uint16_t record_size, uint8_t version,
+                                     uint32_t commit_delay_ms) {
+  this->_flash_address   = flash_address;
+  this->_page_count      = page_count;
+  this->_record          = (uint8_t *)record;
+  this->_record_size     = min(record_size, CONFIG_STORE_MAX_RECORD_SIZE);
+  this->_version         = version;
+  this->_commit_delay_ms = commit_delay_ms;
+  /* Nothing loaded yet, the first commit goes to page 0 */
+  this->_current_page   = page_count - 1;
+  this->_sequence       = 0;
+  this->_loaded_version = version;
+  this->_dirty          = false;
+}
+
+/* Copies the newest valid record into RAM. Only the headers are scanned to
+ * find it, the CRC is checked on that one page unless it turns out bad. A
+ * record of another version or length is copied over the RAM copy as far as
+ * both go, the owner fills the rest in beforehand. False if no page holds a
+ * record, the RAM copy is left alone */
+bool Config_Store::load(void) {
+  uint32_t rejected_below = UINT32_MAX;
+  for (uint8_t attempt = 0; attempt < this->_page_count; attempt++) {
+    bool     found    = false;
+    uint8_t  newest   = 0;
+    uint32_t sequence = 0;
+    for (uint8_t page = 0; page < this->_page_count; page++) {
+      const Config_Store_Header_t *header = this->_page_header(page);
+      if (header->magic == CONFIG_STORE_MAGIC &&
+          header->sequence < rejected_below &&
+          (!found || header->sequence > sequence)) {
+        found    = true;
+        newest   = page;
+        sequence = header->sequence;
+      }
+    }
+    if (!found) {
+      return false;
+    }
+    if (attempt == 0) {
+      /* Commits carry on after the newest page even if it is bad, so every
+       * sequence number is only ever used once */
+      this->_current_page = newest;
+      this->_sequence     = sequence;
+    }
+    if (this->_is_page_valid(newest)) {
+      const Config_Store_Header_t *header = this->_page_header(newest);
+      memcpy(this->_record, header + 1,
+             min(header->length, this->_record_size));
+      this->_loaded_version = header->version;
+      this->_dirty          = false;
+      return true;
+    }
+    rejected_below = sequence; // Torn or stale, try the one before it
+  }
+  return false;
+}
+
+/* The RAM copy changed, it is written once it has been left alone */
+void Config_Store::mark_dirty(uint32_t now_ms) {
+  this->_dirty           = true;
+  this->_dirty_timestamp = now_ms;
+}
+
+void Config_Store::service(uint32_t now_ms) {
+  if (this->_dirty &&
+      now_ms - this->_dirty_timestamp >= this->_commit_delay_ms) {
+    this->_dirty_timestamp = now_ms; // A failed commit waits before retrying
+    this->commit();
+  }
+}
+
+/* Writes the RAM copy to the next page in the ring straight away */
+bool Config_Store::commit(void) {
+  uint8_t page = (this->_current_page + 1) % this->_page_count;
+  /* Fast page programming takes a whole page from a word aligned buffer */
+  uint32_t               buffer[CONFIG_STORE_PAGE_SIZE / sizeof(uint32_t)];
+  Config_Store_Header_t *header = (Config_Store_Header_t *)buffer;
+  memset(buffer, 0xFF, sizeof(buffer));
+  header->magic    = CONFIG_STORE_MAGIC;
+  header->sequence = this->_sequence + 1;
+  header->version  = this->_version;
+  header->reserved = 0;
+  header->length   = this->_record_size;
+  memcpy(header + 1, this->_record, this->_record_size);
+  header->crc = config_store_page_crc(header, this->_record);
+
+  uint32_t address = this->_flash_address + page * CONFIG_STORE_PAGE_SIZE;
+  FLASH_Unlock_Fast();
+  FLASH_ErasePage_Fast(address);
+  FLASH_ProgramPage_Fast(address, buffer);
+  FLASH_Lock_Fast();
+
+  /* Move on either way, a bad page is skipped by load() and rewritten on the
+   * next pass round the ring */
+  this->_current_page = page;
+  this->_sequence     = header->sequence;
+  this->_commit_count++;
+  if (!this->_is_page_valid(page)) {
+    this->_commit_error_count++;
+    return false;
+  }
+  this->_dirty = false;
+  return true;
+}
+
+bool Config_Store::is_dirty(void) { return this->_dirty; }
+
+/* Layout of the record load() found, commits always write the owner's */
+uint8_t Config_Store::get_loaded_version(void) { return this->_loaded_version; }
+
+/* Sequence number of the newest page, counts commits over the unit's life */
+uint32_t Config_Store::get_sequence(void) { return this->_sequence; }
+
+uint32_t Config_Store::get_commit_count(void) { return this->_commit_count; }
+
+uint32_t Config_Store::get_commit_error_count(void) {
+  return this->_commit_error_count;
+}
+
+const Config_Store_Header_t *Config_Store::_page_header(uint8_t page) {
+  uintptr_t address = this->_flash_address + page * CONFIG_STORE_PAGE_SIZE;
+  return (const Config_Store_Header_t *)address;
+}
+
+bool Config_Store::_is_page_valid(uint8_t page) {
+  const Config_Store_Header_t *header = this->_page_header(page);
+  return header->magic == CONFIG_STORE_MAGIC &&
+         header->length <= CONFIG_STORE_MAX_RECORD_SIZE &&
+         header->crc ==
+             config_store_page_crc(header, (const uint8_t *)(header + 1));
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+
+/* CH32 core source */
+#include <core_riscv_ch32yyxx.h>
+
+/* Smallest unit the flash can erase and program in fast mode */
+#define CONFIG_STORE_PAGE_SIZE 256
+
+#define CONFIG_STORE_MAGIC 0x31474643 // "CFG1"
+
+/* Starts every record page, the CRC covers the rest of the header and the
+ * record */
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint32_t sequence; // Higher is newer
+  uint8_t  version;  // Layout of the record, set by the owner
+  uint8_t  reserved;
+  uint16_t length;
+  uint32_t crc;
+} Config_Store_Header_t;
+
+#define CONFIG_STORE_MAX_RECORD_SIZE                                           \
+  (uint16_t)(CONFIG_STORE_PAGE_SIZE - sizeof(Config_Store_Header_t))
+
+/**
+ * Keeps one configuration record in a ring of flash pages. The owner holds
+ * the record in RAM, load() fills it from the newest page with a valid CRC at
+ * boot and every commit erases and programs the page after it. Erases are
+ * spread over the whole ring, and a commit cut short by a power loss (e.g.
+ * while cranking) only damages the page being written, the previous record
+ * is still there on the next boot.
+ *
+ * A record written with another version of the layout is loaded too, as far
+ * as it goes, and get_loaded_version() tells the owner what to migrate from.
+ *
+ * Changes are marked dirty and only written once nothing has changed for
+ * commit_delay_ms, so a burst of settings costs one page. The CPU stalls
+ * while a page is erased and programmed, so the owner only calls service()
+ * while nothing timing critical is running.
+ */
+class Config_Store {
+public:
+  void init_config_store(uint32_t flash_address, uint8_t page_count,
+                         void *record, uint16_t record_size, uint8_t version,
+                         uint32_t commit_delay_ms);
+  bool load(void);
+  void mark_dirty(uint32_t now_ms);
+  void service(uint32_t now_ms);
+  bool commit(void);
+  bool is_dirty(void);
+
+  uint8_t  get_loaded_version(void);
+  uint32_t get_sequence(void);
+  uint32_t get_commit_count(void);
+  uint32_t get_commit_error_count(void);
+
+private:
+  const Config_Store_Header_t *_page_header(uint8_t page);
+  bool                         _is_page_valid(uint8_t page);
+
+  uint32_t _flash_address      = 0;
+  uint8_t  _page_count         = 0;
+  uint8_t *_record             = nullptr;
+  uint16_t _record_size        = 0;
+  uint8_t  _version            = 0;
+  uint8_t  _loaded_version     = 0;
+  uint32_t _commit_delay_ms    = 0;
+  uint8_t  _current_page       = 0; // Holds the record that was loaded
+  uint32_t _sequence           = 0;
+  bool     _dirty              = false;
+  uint32_t _dirty_timestamp    = 0;
+  uint32_t _commit_count       = 0;
+  uint32_t _commit_error_count = 0;
+};
@@ -0,0 +1,33 @@
+#include "boot_profiler.hpp"
+
+static_assert(BOOT_PHASE_COUNT <= 16, "Phases don't fit in the reached mask");
+
+void Boot_Profiler::mark(Boot_Phase_t phase) {
+  if (phase >= BOOT_PHASE_COUNT || this->has_reached(phase)) {
+    return;
+  }
+  this->_phase_us[phase] = micros();
+  this->_reached |= 1 << phase;
+}
+
+bool Boot_Profiler::has_reached(Boot_Phase_t phase) {
+  return phase < BOOT_PHASE_COUNT && (this->_reached & (1 << phase));
+}
+
+/* Since reset, 0 if the phase hasn't been reached */
+uint32_t Boot_Profiler::get_phase_us(Boot_Phase_t phase) {
+  return this->has_reached(phase) ? this->_phase_us[phase] : 0;
+}
+
+/* Time from the last phase reached before this one, 0 if not reached */
+uint32_t Boot_Profiler::get_phase_duration_us(Boot_Phase_t phase) {
+  if (!this->has_reached(phase)) {
+    return 0;
+  }
+  for (int8_t previous = phase - 1; previous >= 0; previous--) {
+    if (this->has_reached((Boot_Phase_t)previous)) {
+      return this->_phase_us[phase] - this->_phase_us[previous];
+    }
+  }
+  return this->_phase_us[phase];
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Arduino.h>
+
+/* Points in setup() that get a timestamp, in the order they are reached */
+typedef enum : uint8_t {
+  BOOT_PHASE_SETUP_START,
+  BOOT_PHASE_CONFIG_LOADED,
+  BOOT_PHASE_INPUTS_ARMED,
+  BOOT_PHASE_CLOCK_CALIBRATED,
+  BOOT_PHASE_BRAND_SELECTED,
+  BOOT_PHASE_POT_READY,
+  BOOT_PHASE_DRIVER_READY,
+  BOOT_PHASE_SETUP_DONE,
+  BOOT_PHASE_FIRST_INPUT, // First input event handled by loop()
+  BOOT_PHASE_COUNT,
+} Boot_Phase_t;
+
+/**
+ * Micro-second timestamps of each boot phase since reset, so the time to the
+ * first accepted input can be measured on the bench. Only the first mark()
+ * of a phase counts. Read the results out with the debugger.
+ */
+class Boot_Profiler {
+public:
+  void mark(Boot_Phase_t phase);
+
+  bool     has_reached(Boot_Phase_t phase);
+  uint32_t get_phase_us(Boot_Phase_t phase);
+  uint32_t get_phase_duration_us(Boot_Phase_t phase);
+
+private:
+  uint32_t _phase_us[BOOT_PHASE_COUNT] = {};
+  uint16_t _reached                    = 0; // Bit per phase
+};
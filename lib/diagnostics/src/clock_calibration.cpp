@@ -0,0 +1,99 @@
+#include "clock_calibration.hpp"
+
+/* Reference periods averaged per measurement */
+#define CLOCK_CALIBRATION_PERIODS 16
+
+void Clock_Calibration::init_clock_calibration(Timer_Capture *capture,
+                                               uint32_t capture_tick_hz,
+                                               uint32_t reference_hz) {
+  this->_capture         = capture;
+  this->_capture_tick_hz = capture_tick_hz;
+  this->_reference_hz    = reference_hz;
+}
+
+/* One reference period, enough to tell whether anything is on the input
+ * without waiting out a whole measurement on every normal boot */
+bool Clock_Calibration::is_reference_present(uint32_t timeout_ms) {
+  int32_t error_ppm;
+  return this->measure_error_ppm(&error_ppm, 1, timeout_ms);
+}
+
+/* Positive when the HSI runs fast, i.e. a reference period takes more
+ * ticks than it should. False if the reference doesn't show up in time */
+bool Clock_Calibration::measure_error_ppm(int32_t *error_ppm, uint16_t periods,
+                                          uint32_t timeout_ms) {
+  Capture_Edge_t edge;
+  uint32_t       measured_ticks   = 0;
+  uint16_t       measured_periods = 0;
+  bool           have_first_edge  = false;
+  uint16_t       previous_edge    = 0;
+  uint32_t       start_ms         = millis();
+
+  this->_capture->start();
+  while (measured_periods < periods && millis() - start_ms < timeout_ms) {
+    if (!this->_capture->poll(&edge) || !edge.rising) {
+      continue;
+    }
+    if (have_first_edge) {
+      measured_ticks += (uint16_t)(edge.timestamp - previous_edge);
+      measured_periods++;
+    }
+    previous_edge   = edge.timestamp;
+    have_first_edge = true;
+  }
+  this->_capture->stop();
+
+  if (measured_periods < periods) {
+    return false;
+  }
+  int64_t expected_ticks =
+      (int64_t)periods * this->_capture_tick_hz / this->_reference_hz;
+  *error_ppm = (int32_t)(((int64_t)measured_ticks - expected_ticks) *
+                         1000000 / expected_ticks);
+  return true;
+}
+
+/* Steps the trim towards the reference until the error stops shrinking,
+ * then keeps the best setting seen */
+bool Clock_Calibration::calibrate(uint32_t timeout_ms) {
+  int32_t error_ppm;
+  if (!this->measure_error_ppm(&error_ppm, CLOCK_CALIBRATION_PERIODS,
+                               timeout_ms)) {
+    return false;
+  }
+
+  uint8_t best_trim      = get_hsi_trim();
+  int32_t best_error_ppm = error_ppm;
+  int8_t  step           = (error_ppm > 0) ? -1 : 1;
+  uint8_t trim           = best_trim;
+  while (error_ppm != 0 && trim + step >= 0 && trim + step <= HSI_TRIM_MAX) {
+    trim += step;
+    set_hsi_trim(trim);
+    if (!this->measure_error_ppm(&error_ppm, CLOCK_CALIBRATION_PERIODS,
+                                 timeout_ms)) {
+      break;
+    }
+    if (abs(error_ppm) >= abs(best_error_ppm)) {
+      break;
+    }
+    best_trim      = trim;
+    best_error_ppm = error_ppm;
+  }
+  set_hsi_trim(best_trim);
+  this->_residual_error_ppm = best_error_ppm;
+  return true;
+}
+
+uint8_t Clock_Calibration::get_hsi_trim(void) {
+  return (RCC->CTLR & RCC_CTLR_HSITRIM) >> HSI_TRIM_SHIFT;
+}
+
+void Clock_Calibration::set_hsi_trim(uint8_t trim) {
+  if (trim <= HSI_TRIM_MAX) {
+    RCC_AdjustHSICalibrationValue(trim);
+  }
+}
+
+int32_t Clock_Calibration::get_residual_error_ppm(void) {
+  return this->_residual_error_ppm;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "timer_capture.hpp"
+#include <Arduino.h>
+
+/* HSITRIM field in RCC->CTLR */
+#define HSI_TRIM_SHIFT   3
+#define HSI_TRIM_MAX     0x1F
+#define HSI_TRIM_DEFAULT 0x10
+
+/**
+ * Trims the HSI against an external reference clock on the capture input.
+ * SysTick, the timers and millis() all run off the HSI, so they can't be used
+ * to measure it, a reference of known frequency has to come in from outside
+ * (e.g. a 1 kHz square wave from a test fixture). Every protocol tick is
+ * derived from the HSI, so trimming it corrects all of them at once.
+ */
+class Clock_Calibration {
+public:
+  void init_clock_calibration(Timer_Capture *capture, uint32_t capture_tick_hz,
+                              uint32_t reference_hz);
+  bool is_reference_present(uint32_t timeout_ms);
+  bool measure_error_ppm(int32_t *error_ppm, uint16_t periods,
+                         uint32_t timeout_ms);
+  bool calibrate(uint32_t timeout_ms);
+
+  static uint8_t get_hsi_trim(void);
+  static void    set_hsi_trim(uint8_t trim);
+
+  int32_t get_residual_error_ppm(void);
+
+private:
+  Timer_Capture *_capture;
+  uint32_t       _capture_tick_hz;
+  uint32_t       _reference_hz;
+  int32_t        _residual_error_ppm = 0;
+};
@@ -0,0 +1,20 @@
+#include "isr_profiler.hpp"
+
+uint32_t ISR_Profiler::get_worst_case_ticks(void) {
+  return this->_worst_case_ticks;
+}
+
+uint32_t ISR_Profiler::get_worst_case_ns(void) {
+  uint32_t tick_rate_hz = (SysTick->CTLR & SYSTICK_CTLR_STCLK_BM)
+                              ? SystemCoreClock
+                              : SystemCoreClock / 8;
+  return (uint32_t)(((uint64_t)this->_worst_case_ticks * 1000000000ULL) /
+                    tick_rate_hz);
+}
+
+uint32_t ISR_Profiler::get_sample_count(void) { return this->_sample_count; }
+
+void ISR_Profiler::reset(void) {
+  this->_worst_case_ticks = 0;
+  this->_sample_count     = 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Arduino.h>
+
+/* CH32 core source */
+#include <core_riscv_ch32yyxx.h>
+
+/* QingKe SysTick control register bits */
+#define SYSTICK_CTLR_STCLK_BM (1 << 2) // Set: HCLK, clear: HCLK / 8
+#define SYSTICK_CTLR_MODE_BM  (1 << 4) // Set: count down, clear: count up
+
+/**
+ * Records the worst-case execution time of an interrupt handler using the
+ * SysTick counter that already drives millis(). Call timestamp() on entry and
+ * record() just before returning.
+ */
+class ISR_Profiler {
+public:
+  static inline uint32_t timestamp(void) { return (uint32_t)SysTick->CNT; }
+
+  inline void record(uint32_t start_ticks) {
+    uint32_t end_ticks = timestamp();
+    uint32_t elapsed   = (SysTick->CTLR & SYSTICK_CTLR_MODE_BM)
+                             ? start_ticks - end_ticks
+                             : end_ticks - start_ticks;
+    /* A SysTick reload in the middle of the handler gives a bogus sample */
+    if (elapsed > _max_valid_ticks) {
+      return;
+    }
+    if (elapsed > this->_worst_case_ticks) {
+      this->_worst_case_ticks = elapsed;
+    }
+    this->_sample_count++;
+  }
+
+  uint32_t get_worst_case_ticks(void);
+  uint32_t get_worst_case_ns(void);
+  uint32_t get_sample_count(void);
+  void     reset(void);
+
+private:
+  static const uint32_t _max_valid_ticks = 0xFFFF;
+
+  volatile uint32_t _worst_case_ticks = 0;
+  volatile uint32_t _sample_count     = 0;
+};
@@ -0,0 +1,99 @@
+#include "timer_capture.hpp"
+
+void Timer_Capture::init_timer_capture(TIM_TypeDef *timer, uint32_t tick_hz) {
+  this->_timer = timer;
+  this->_enable_clock(true);
+
+  /* Free running, edge timestamps are subtracted with 16-bit wrap */
+  TIM_TimeBaseInitTypeDef time_base = {0};
+  time_base.TIM_Prescaler           = SystemCoreClock / tick_hz - 1;
+  time_base.TIM_CounterMode         = TIM_CounterMode_Up;
+  time_base.TIM_Period              = 0xFFFF;
+  time_base.TIM_ClockDivision       = TIM_CKD_DIV1;
+  TIM_TimeBaseInit(this->_timer, &time_base);
+
+  TIM_ICInitTypeDef input_capture = {0};
+  input_capture.TIM_ICPrescaler   = TIM_ICPSC_DIV1;
+  input_capture.TIM_ICFilter      = 0;
+  input_capture.TIM_Channel       = TIM_Channel_1;
+  input_capture.TIM_ICPolarity    = TIM_ICPolarity_Rising;
+  input_capture.TIM_ICSelection   = TIM_ICSelection_DirectTI;
+  TIM_ICInit(this->_timer, &input_capture);
+  input_capture.TIM_Channel     = TIM_Channel_2;
+  input_capture.TIM_ICPolarity  = TIM_ICPolarity_Falling;
+  input_capture.TIM_ICSelection = TIM_ICSelection_IndirectTI;
+  TIM_ICInit(this->_timer, &input_capture);
+}
+
+void Timer_Capture::start(void) {
+  this->_has_pending_edge = false;
+  this->_enable_clock(true);
+  TIM_SetCounter(this->_timer, 0);
+  TIM_ClearFlag(this->_timer, TIM_FLAG_CC1 | TIM_FLAG_CC2 | TIM_FLAG_CC1OF |
+                                  TIM_FLAG_CC2OF);
+  TIM_Cmd(this->_timer, ENABLE);
+}
+
+/* Also gates the timer clock, the configuration is kept for start() */
+void Timer_Capture::stop(void) {
+  TIM_Cmd(this->_timer, DISABLE);
+  this->_enable_clock(false);
+}
+
+/* Returns the oldest edge not yet collected, if any. Reading a capture
+ * register clears its flag */
+bool Timer_Capture::poll(Capture_Edge_t *edge) {
+  if (this->_has_pending_edge) {
+    *edge                   = this->_pending_edge;
+    this->_has_pending_edge = false;
+    return true;
+  }
+  if (TIM_GetFlagStatus(this->_timer, TIM_FLAG_CC1OF | TIM_FLAG_CC2OF)) {
+    /* An edge was overwritten before we got to it */
+    this->_overcapture_count++;
+    TIM_ClearFlag(this->_timer, TIM_FLAG_CC1OF | TIM_FLAG_CC2OF);
+  }
+  bool rising_ready  = TIM_GetFlagStatus(this->_timer, TIM_FLAG_CC1);
+  bool falling_ready = TIM_GetFlagStatus(this->_timer, TIM_FLAG_CC2);
+  if (rising_ready && falling_ready) {
+    /* Both pending, hand out whichever is further behind the counter first
+     * and keep the other for the next call */
+    uint16_t now          = TIM_GetCounter(this->_timer);
+    uint16_t rising       = TIM_GetCapture1(this->_timer);
+    uint16_t falling      = TIM_GetCapture2(this->_timer);
+    bool     rising_first = (uint16_t)(now - rising) >=
+                        (uint16_t)(now - falling);
+    edge->rising    = rising_first;
+    edge->timestamp = (rising_first) ? rising : falling;
+    this->_pending_edge.rising    = !rising_first;
+    this->_pending_edge.timestamp = (rising_first) ? falling : rising;
+    this->_has_pending_edge       = true;
+    return true;
+  }
+  if (rising_ready) {
+    edge->rising    = true;
+    edge->timestamp = TIM_GetCapture1(this->_timer);
+    return true;
+  }
+  if (falling_ready) {
+    edge->rising    = false;
+    edge->timestamp = TIM_GetCapture2(this->_timer);
+    return true;
+  }
+  return false;
+}
+
+uint32_t Timer_Capture::get_overcapture_count(void) {
+  return this->_overcapture_count;
+}
+
+void Timer_Capture::_enable_clock(bool enable) {
+  FunctionalState state = (enable) ? ENABLE : DISABLE;
+  if (this->_timer == TIM2) {
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM2, state);
+  } else if (this->_timer == TIM3) {
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM3, state);
+  } else {
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM1, state);
+  }
+}
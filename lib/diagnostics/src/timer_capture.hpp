@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+
+typedef struct {
+  uint16_t timestamp; // Timer ticks, wraps every 65536
+  bool     rising;
+} Capture_Edge_t;
+
+/**
+ * Timestamps both edges of the signal on a timer's CH1 input. CH1 captures
+ * rising edges straight off TI1 and CH2 captures falling edges off the same
+ * input, so nothing is lost between an edge and re-arming. Polled rather than
+ * interrupt driven, the callers are blocking calibration and test routines.
+ */
+class Timer_Capture {
+public:
+  void init_timer_capture(TIM_TypeDef *timer, uint32_t tick_hz);
+  void start(void);
+  void stop(void);
+  bool poll(Capture_Edge_t *edge);
+
+  uint32_t get_overcapture_count(void);
+
+private:
+  void _enable_clock(bool enable);
+
+  TIM_TypeDef   *_timer;
+  Capture_Edge_t _pending_edge;
+  bool           _has_pending_edge  = false;
+  uint32_t       _overcapture_count = 0;
+};
@@ -0,0 +1,147 @@
+#include "button_gesture.hpp"
+
+void Button_Gesture::init_button_gesture(uint16_t held_threshold_ms,
+                                         uint16_t double_press_window_ms,
+                                         uint16_t debounce_ms) {
+  this->_held_threshold_ms      = held_threshold_ms;
+  this->_double_press_window_ms = double_press_window_ms;
+  this->_debounce_ms            = debounce_ms;
+  this->_state                  = GESTURE_STATE_IDLE;
+  this->_state_before_press     = GESTURE_STATE_IDLE;
+  this->_button_pressed         = false;
+  this->_bounced                = false;
+}
+
+Button_Gesture_t Button_Gesture::on_button_edge(bool     pressed,
+                                                uint32_t timestamp_ms) {
+  /* Drop repeated levels and contact bounce right after an accepted edge */
+  if (pressed == this->_button_pressed) {
+    return BUTTON_GESTURE_NONE;
+  }
+  if (timestamp_ms - this->_last_edge_timestamp_ms < this->_debounce_ms) {
+    this->_bounced = true;
+    return BUTTON_GESTURE_NONE;
+  }
+  this->_button_pressed         = pressed;
+  this->_bounced                = false;
+  this->_last_edge_timestamp_ms = timestamp_ms;
+  if (pressed) {
+    this->_state_before_press = this->_state;
+  }
+
+  switch (this->_state) {
+  case GESTURE_STATE_IDLE:
+    if (pressed) {
+      this->_state              = GESTURE_STATE_PRESSED;
+      this->_state_timestamp_ms = timestamp_ms;
+    }
+    break;
+
+  case GESTURE_STATE_PRESSED:
+    if (!pressed) {
+      if (timestamp_ms - this->_state_timestamp_ms >=
+          this->_held_threshold_ms) {
+        /* Released late but we hadn't ticked yet, it still was a hold */
+        this->_state = GESTURE_STATE_IDLE;
+        return BUTTON_GESTURE_HELD;
+      }
+      this->_state              = GESTURE_STATE_RELEASED;
+      this->_state_timestamp_ms = timestamp_ms;
+    }
+    break;
+
+  case GESTURE_STATE_RELEASED:
+    if (pressed) {
+      if (timestamp_ms - this->_state_timestamp_ms >=
+          this->_double_press_window_ms) {
+        /* Window had closed before this press, report the first one and
+         * start over with this press */
+        this->_state_timestamp_ms = timestamp_ms;
+        this->_state              = GESTURE_STATE_PRESSED;
+        this->_state_before_press = GESTURE_STATE_IDLE;
+        return BUTTON_GESTURE_SINGLE_PRESS;
+      }
+      this->_state = GESTURE_STATE_SECOND_PRESS;
+    }
+    break;
+
+  case GESTURE_STATE_HELD:
+    if (!pressed) {
+      this->_state = GESTURE_STATE_IDLE;
+      return BUTTON_GESTURE_HELD;
+    }
+    break;
+
+  case GESTURE_STATE_SECOND_PRESS:
+    if (!pressed) {
+      this->_state = GESTURE_STATE_IDLE;
+      return BUTTON_GESTURE_DOUBLE_PRESS;
+    }
+    break;
+
+  case GESTURE_STATE_WAIT_FOR_RELEASE:
+    if (!pressed) {
+      this->_state = GESTURE_STATE_IDLE;
+    }
+    break;
+
+  default:
+    break;
+  }
+  return BUTTON_GESTURE_NONE;
+}
+
+Button_Gesture_t Button_Gesture::tick(uint32_t now_ms, bool button_pressed) {
+  /* If the final edge of a bounce was dropped, re-sync to the live level */
+  if (button_pressed != this->_button_pressed &&
+      now_ms - this->_last_edge_timestamp_ms >= this->_debounce_ms) {
+    if (!button_pressed && this->_bounced) {
+      /* Released again within the debounce time, the press was a spike on
+       * the line rather than the button. Forget it instead of re-syncing
+       * it into a short press */
+      this->_button_pressed = false;
+      this->_bounced        = false;
+      this->_state          = this->_state_before_press;
+      return BUTTON_GESTURE_NONE;
+    }
+    Button_Gesture_t gesture = this->on_button_edge(button_pressed, now_ms);
+    if (gesture != BUTTON_GESTURE_NONE) {
+      return gesture;
+    }
+  }
+
+  switch (this->_state) {
+  case GESTURE_STATE_PRESSED:
+    if (now_ms - this->_state_timestamp_ms >= this->_held_threshold_ms) {
+      /* Not reported yet, the knob may still turn before the release */
+      this->_state = GESTURE_STATE_HELD;
+    }
+    break;
+
+  case GESTURE_STATE_RELEASED:
+    if (now_ms - this->_state_timestamp_ms >= this->_double_press_window_ms) {
+      this->_state = GESTURE_STATE_IDLE;
+      return BUTTON_GESTURE_SINGLE_PRESS;
+    }
+    break;
+
+  default:
+    break;
+  }
+  return BUTTON_GESTURE_NONE;
+}
+
+/* Returns true if the rotation happened with the button down. The press then
+ * acts as a modifier and can no longer turn into a gesture of its own, even
+ * one that is only waiting for the release to be reported */
+bool Button_Gesture::on_rotation(void) {
+  if (!this->_button_pressed) {
+    return false;
+  }
+  this->_state = GESTURE_STATE_WAIT_FOR_RELEASE;
+  return true;
+}
+
+bool Button_Gesture::is_pending(void) {
+  return this->_state != GESTURE_STATE_IDLE;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+
+typedef enum {
+  BUTTON_GESTURE_NONE,
+  BUTTON_GESTURE_SINGLE_PRESS,
+  BUTTON_GESTURE_DOUBLE_PRESS,
+  BUTTON_GESTURE_HELD,
+} Button_Gesture_t;
+
+typedef enum {
+  GESTURE_STATE_IDLE,
+  GESTURE_STATE_PRESSED,          // Waiting to see if this becomes a hold
+  GESTURE_STATE_RELEASED,         // Double press window is open
+  GESTURE_STATE_HELD,             // Held long enough, reported on release
+  GESTURE_STATE_SECOND_PRESS,     // Double press, reported on release
+  GESTURE_STATE_WAIT_FOR_RELEASE, // Gesture reported, ignore until released
+} Button_Gesture_State_t;
+
+/**
+ * Non-blocking single/double/held recogniser. Button edges are fed in with
+ * the timestamp the ISR captured, tick() handles the timeouts. Neither ever
+ * waits, so loop() keeps servicing rotation while a gesture is in progress.
+ *
+ * Held and double presses are only reported once the button is released,
+ * turning the knob before then makes the press a modifier instead. A press
+ * that is released again within the debounce time is a spike and is dropped.
+ */
+class Button_Gesture {
+public:
+  void init_button_gesture(uint16_t held_threshold_ms,
+                           uint16_t double_press_window_ms,
+                           uint16_t debounce_ms);
+
+  Button_Gesture_t on_button_edge(bool pressed, uint32_t timestamp_ms);
+  Button_Gesture_t tick(uint32_t now_ms, bool button_pressed);
+  bool             on_rotation(void);
+  bool             is_pending(void);
+
+private:
+  Button_Gesture_State_t _state                  = GESTURE_STATE_IDLE;
+  Button_Gesture_State_t _state_before_press     = GESTURE_STATE_IDLE;
+  bool                   _button_pressed         = false;
+  bool                   _bounced                = false;
+  uint32_t               _state_timestamp_ms     = 0;
+  uint32_t               _last_edge_timestamp_ms = 0;
+  uint16_t               _held_threshold_ms      = 500;
+  uint16_t               _double_press_window_ms = 1000;
+  uint16_t               _debounce_ms            = 20;
+};
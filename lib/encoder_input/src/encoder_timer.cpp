@@ -0,0 +1,57 @@
+#include "encoder_timer.hpp"
+
+void Encoder_Timer::init_encoder_timer(TIM_TypeDef         *timer,
+                                       Encoder_Resolution_t resolution,
+                                       uint16_t             input_filter,
+                                       bool reverse_direction) {
+  this->_timer             = timer;
+  this->_edges_per_detent  = (uint8_t)resolution;
+  this->_reverse_direction = reverse_direction;
+
+  if (this->_timer == TIM2) {
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM2, ENABLE);
+  } else if (this->_timer == TIM3) {
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM3, ENABLE);
+  } else {
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM1, ENABLE);
+  }
+
+  /* Free running over the full 16-bit range, wrap is handled in read_delta */
+  TIM_TimeBaseInitTypeDef time_base = {0};
+  time_base.TIM_Prescaler           = 0;
+  time_base.TIM_CounterMode         = TIM_CounterMode_Up;
+  time_base.TIM_Period              = 0xFFFF;
+  time_base.TIM_ClockDivision       = TIM_CKD_DIV1;
+  TIM_TimeBaseInit(this->_timer, &time_base);
+
+  /* Count on both edges of both channels (x4) */
+  TIM_EncoderInterfaceConfig(this->_timer, TIM_EncoderMode_TI12,
+                             TIM_ICPolarity_Rising, TIM_ICPolarity_Rising);
+
+  /* The input capture digital filter doubles as a contact bounce filter */
+  TIM_ICInitTypeDef input_capture = {0};
+  input_capture.TIM_ICPolarity    = TIM_ICPolarity_Rising;
+  input_capture.TIM_ICSelection   = TIM_ICSelection_DirectTI;
+  input_capture.TIM_ICPrescaler   = TIM_ICPSC_DIV1;
+  input_capture.TIM_ICFilter      = input_filter;
+  input_capture.TIM_Channel       = TIM_Channel_1;
+  TIM_ICInit(this->_timer, &input_capture);
+  input_capture.TIM_Channel = TIM_Channel_2;
+  TIM_ICInit(this->_timer, &input_capture);
+
+  TIM_SetCounter(this->_timer, 0);
+  this->_previous_count  = 0;
+  this->_remainder_edges = 0;
+  TIM_Cmd(this->_timer, ENABLE);
+}
+
+int16_t Encoder_Timer::read_delta(void) {
+  uint16_t current_count = TIM_GetCounter(this->_timer);
+  /* Unsigned 16-bit subtraction handles the counter wrapping either way */
+  this->_remainder_edges += (int16_t)(current_count - this->_previous_count);
+  this->_previous_count = current_count;
+
+  int16_t detents = this->_remainder_edges / this->_edges_per_detent;
+  this->_remainder_edges -= detents * this->_edges_per_detent;
+  return (this->_reverse_direction) ? -detents : detents;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "quadrature_decoder.hpp"
+
+/**
+ * Counts the encoder in a general purpose timer running in encoder interface
+ * mode, so rotation costs no CPU time at all. The timer only accepts encoder
+ * channels on its TI1/TI2 inputs (CH1/CH2). On TIM2 that is PA0/PA1.
+ */
+class Encoder_Timer {
+public:
+  void    init_encoder_timer(TIM_TypeDef *timer, Encoder_Resolution_t resolution,
+                             uint16_t input_filter, bool reverse_direction);
+  int16_t read_delta(void);
+
+private:
+  TIM_TypeDef *_timer;
+  uint16_t     _previous_count   = 0;
+  int16_t      _remainder_edges  = 0;
+  uint8_t      _edges_per_detent = ENCODER_RESOLUTION_1X;
+  bool         _reverse_direction = false;
+};
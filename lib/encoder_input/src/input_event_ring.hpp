@@ -0,0 +1,80 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+typedef enum : uint8_t {
+  INPUT_EVENT_ROTATION,
+  INPUT_EVENT_BUTTON_PRESSED,
+  INPUT_EVENT_BUTTON_RELEASED,
+} Input_Event_Type_t;
+
+typedef struct {
+  uint32_t           timestamp_ms;
+  Input_Event_Type_t type;
+  int8_t             value; // Detents for rotation events, positive is CW
+} Input_Event_t;
+
+/**
+ * Single-producer/single-consumer ring of input events. The producer is the
+ * input ISR context, the consumer is loop(). Each side only ever writes its
+ * own index, so no interrupt masking is needed on either side.
+ */
+template <uint8_t SIZE> class Input_Event_Ring {
+  static_assert(SIZE >= 2 && SIZE <= 128 && (SIZE & (SIZE - 1)) == 0,
+                "Ring size must be a power of two no larger than 128");
+
+public:
+  /* Producer side, only call from the input ISR context */
+  bool push(Input_Event_Type_t type, int8_t value, uint32_t timestamp_ms) {
+    uint8_t head = this->_head.load(std::memory_order_relaxed);
+    uint8_t used = head - this->_tail.load(std::memory_order_acquire);
+    if (used >= SIZE) {
+      this->_overflow_count = this->_overflow_count + 1;
+      return false;
+    }
+    Input_Event_t *event = &this->_events[head & (SIZE - 1)];
+    event->timestamp_ms  = timestamp_ms;
+    event->type          = type;
+    event->value         = value;
+    this->_head.store(head + 1, std::memory_order_release);
+
+    if (used + 1 > this->_high_water_mark) {
+      this->_high_water_mark = used + 1;
+    }
+    return true;
+  }
+
+  /* Consumer side, only call from loop() */
+  bool pop(Input_Event_t *event) {
+    uint8_t tail = this->_tail.load(std::memory_order_relaxed);
+    if (tail == this->_head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *event = this->_events[tail & (SIZE - 1)];
+    this->_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /* Consumer side, drops everything pushed so far */
+  void discard(void) {
+    this->_tail.store(this->_head.load(std::memory_order_acquire),
+                      std::memory_order_release);
+  }
+
+  bool is_empty(void) {
+    return this->_tail.load(std::memory_order_relaxed) ==
+           this->_head.load(std::memory_order_acquire);
+  }
+
+  uint32_t get_overflow_count(void) { return this->_overflow_count; }
+  uint8_t  get_high_water_mark(void) { return this->_high_water_mark; }
+
+private:
+  Input_Event_t        _events[SIZE];
+  std::atomic<uint8_t> _head{0};
+  std::atomic<uint8_t> _tail{0};
+
+  volatile uint32_t _overflow_count  = 0;
+  volatile uint8_t  _high_water_mark = 0;
+};
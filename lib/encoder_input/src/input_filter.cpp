@@ -0,0 +1,62 @@
+#include "input_filter.hpp"
+
+void Input_Filter::init_input_filter(uint32_t initial_state, uint32_t pin_mask,
+                                     uint8_t lockout_samples) {
+  this->_pin_mask        = pin_mask & ((1UL << INPUT_FILTER_MAX_PINS) - 1);
+  this->_filtered_state  = initial_state & this->_pin_mask;
+  this->_locked_mask     = 0;
+  this->_bounced_mask    = 0;
+  this->_lockout_samples = (lockout_samples) ? lockout_samples : 1;
+  memset(this->_lockouts, 0, sizeof(this->_lockouts));
+}
+
+/* Returns the mask of pins whose filtered level changed on this sample */
+uint32_t Input_Filter::sample(uint32_t raw_state) {
+  /* Count the windows down, a pin whose window ends here can take its next
+   * edge on this same sample */
+  uint32_t locked = this->_locked_mask;
+  while (locked) {
+    uint8_t bit = __builtin_ctz(locked);
+    if (--this->_lockouts[bit] == 0) {
+      this->_locked_mask &= ~(1UL << bit);
+    }
+    locked &= locked - 1;
+  }
+  this->_bounced_mask &= this->_locked_mask;
+
+  uint32_t differing = (raw_state ^ this->_filtered_state) & this->_pin_mask;
+
+  /* Locked pins away from their filtered level are bouncing, counted once per
+   * window */
+  uint32_t bounced = differing & this->_locked_mask & ~this->_bounced_mask;
+  if (bounced) {
+    this->_rejected_glitches =
+        this->_rejected_glitches + __builtin_popcount(bounced);
+    this->_bounced_mask |= bounced;
+  }
+
+  uint32_t changed = differing & ~this->_locked_mask;
+  uint32_t pending = changed;
+  while (pending) {
+    this->_lockouts[__builtin_ctz(pending)] = this->_lockout_samples;
+    pending &= pending - 1;
+  }
+  this->_locked_mask |= changed;
+  this->_filtered_state ^= changed;
+  return changed;
+}
+
+/* No window running and nothing waiting to be reported, sampling can stop */
+bool Input_Filter::is_settled(uint32_t raw_state) {
+  return this->_locked_mask == 0 &&
+         ((raw_state ^ this->_filtered_state) & this->_pin_mask) == 0;
+}
+
+uint32_t Input_Filter::get_filtered_state(void) {
+  return this->_filtered_state;
+}
+
+/* Pins seen bouncing inside their lock-out window */
+uint32_t Input_Filter::get_rejected_glitch_count(void) {
+  return this->_rejected_glitches;
+}
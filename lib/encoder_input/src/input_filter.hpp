@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define INPUT_FILTER_MAX_PINS 16
+
+/**
+ * Lock-out debounce for a set of pins on one GPIO port, fed from a periodic
+ * timer. The first edge on a pin is reported on the sample that sees it, then
+ * that pin is ignored for lockout_samples samples so its contact bounce can't
+ * turn into more edges. Once the window is over the pin follows the raw level
+ * again, a level that changed back during the window is reported then. Bounce
+ * seen inside a window is counted, never reported.
+ *
+ * The windows are counted in samples, so sample() has to keep running at a
+ * fixed rate until is_settled(). Between edges it can be stopped.
+ */
+class Input_Filter {
+public:
+  void     init_input_filter(uint32_t initial_state, uint32_t pin_mask,
+                             uint8_t lockout_samples);
+  uint32_t sample(uint32_t raw_state);
+  bool     is_settled(uint32_t raw_state);
+  uint32_t get_filtered_state(void);
+  uint32_t get_rejected_glitch_count(void);
+
+private:
+  uint32_t _pin_mask        = 0;
+  uint32_t _filtered_state  = 0;
+  uint32_t _locked_mask     = 0; // Pins inside their lock-out window
+  uint32_t _bounced_mask    = 0; // Locked pins already counted as bouncing
+  uint8_t  _lockout_samples = 1;
+  uint8_t  _lockouts[INPUT_FILTER_MAX_PINS] = {0}; // Samples left per pin
+
+  volatile uint32_t _rejected_glitches = 0;
+};
@@ -0,0 +1,68 @@
+/**
+ * Table driven quadrature decoder. Both encoder channels are sampled on every
+ * edge and the previous/current AB state pair indexes a 16 entry Gray-code
+ * transition table. Bounce on a single channel toggles back and forth between
+ * two adjacent states which nets out to zero, so it can never produce a step.
+ *
+ * AB state is (A << 1) | B. CW rotation walks 00 -> 01 -> 11 -> 10 -> 00
+ */
+
+#include "quadrature_decoder.hpp"
+
+/* Marks a transition where both channels changed, i.e. we missed an edge */
+#define QUADRATURE_INVALID 2
+
+static const int8_t quadrature_transition_table[16] = {
+    /* 00 -> */ 0,  1,  -1, QUADRATURE_INVALID,
+    /* 01 -> */ -1, 0,  QUADRATURE_INVALID, 1,
+    /* 10 -> */ 1,  QUADRATURE_INVALID, 0,  -1,
+    /* 11 -> */ QUADRATURE_INVALID, -1, 1, 0,
+};
+
+void Quadrature_Decoder::init_quadrature_decoder(
+    uint8_t initial_ab_state, Encoder_Resolution_t resolution) {
+  this->_previous_ab_state = initial_ab_state & 0b11;
+  this->_edges_per_detent  = (uint8_t)resolution;
+  this->_accumulator       = 0;
+  this->_last_direction    = 0;
+}
+
+int8_t Quadrature_Decoder::update(uint8_t ab_state) {
+  ab_state &= 0b11;
+  int8_t step =
+      quadrature_transition_table[(this->_previous_ab_state << 2) | ab_state];
+  this->_previous_ab_state = ab_state;
+
+  if (step == QUADRATURE_INVALID) {
+    /* Both channels changed, so we skipped over one state. The knob can only
+     * have kept turning the same way, so count two edges in that direction */
+    this->_invalid_transitions++;
+    step = this->_last_direction * 2;
+  } else if (step != 0) {
+    if (step != this->_last_direction && this->_accumulator != 0) {
+      /* Direction flipped part way through a detent. This is bounce and is
+       * cancelled out by the accumulator */
+      this->_reversals++;
+    }
+    this->_last_direction = step;
+  }
+
+  this->_accumulator += step;
+  if (this->_accumulator >= (int8_t)this->_edges_per_detent) {
+    this->_accumulator -= this->_edges_per_detent;
+    return 1;
+  }
+  if (this->_accumulator <= -(int8_t)this->_edges_per_detent) {
+    this->_accumulator += this->_edges_per_detent;
+    return -1;
+  }
+  return 0;
+}
+
+uint32_t Quadrature_Decoder::get_invalid_transition_count(void) {
+  return this->_invalid_transitions;
+}
+
+uint32_t Quadrature_Decoder::get_reversal_count(void) {
+  return this->_reversals;
+}
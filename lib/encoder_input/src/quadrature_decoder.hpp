@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+Number of valid quadrature edges that make up a single reported count. Most
+detented encoders travel a full Gray-code cycle (4 edges) per detent, so 1x is
+the default. 2x and 4x are for encoders with 2 or 1 edges per detent.
+*/
+typedef enum {
+  ENCODER_RESOLUTION_1X = 4,
+  ENCODER_RESOLUTION_2X = 2,
+  ENCODER_RESOLUTION_4X = 1,
+} Encoder_Resolution_t;
+
+class Quadrature_Decoder {
+public:
+  void   init_quadrature_decoder(uint8_t              initial_ab_state,
+                                 Encoder_Resolution_t resolution);
+  int8_t update(uint8_t ab_state);
+
+  uint32_t get_invalid_transition_count(void);
+  uint32_t get_reversal_count(void);
+
+private:
+  uint8_t  _previous_ab_state   = 0b11;
+  int8_t   _accumulator         = 0;
+  int8_t   _last_direction      = 0;
+  uint8_t  _edges_per_detent    = ENCODER_RESOLUTION_1X;
+  uint32_t _invalid_transitions = 0;
+  uint32_t _reversals           = 0;
+};
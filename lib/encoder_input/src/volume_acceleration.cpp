@@ -0,0 +1,42 @@
+#include "volume_acceleration.hpp"
+
+void Volume_Accelerator::init_volume_accelerator(
+    const Acceleration_Point_t *curve, uint8_t curve_length) {
+  this->_curve              = curve;
+  this->_curve_length       = curve_length;
+  this->_detent_interval_ms = UINT16_MAX;
+  this->_previous_direction = 0;
+}
+
+int16_t Volume_Accelerator::on_rotation(int16_t detents, uint32_t timestamp_ms) {
+  if (detents == 0) {
+    return 0;
+  }
+  int8_t   direction = (detents > 0) ? 1 : -1;
+  uint16_t count     = (detents > 0) ? detents : -detents;
+  uint32_t elapsed   = (timestamp_ms - this->_previous_timestamp_ms) / count;
+  this->_previous_timestamp_ms = timestamp_ms;
+
+  if (direction != this->_previous_direction ||
+      elapsed >= this->_curve[this->_curve_length - 1].max_detent_interval_ms) {
+    /* Slow turn or a change of direction starts from scratch at 1:1 */
+    this->_detent_interval_ms =
+        (elapsed > UINT16_MAX) ? UINT16_MAX : (uint16_t)elapsed;
+  } else {
+    /* Average over the last few detents so one quick detent doesn't jump */
+    this->_detent_interval_ms =
+        (uint16_t)((3 * (uint32_t)this->_detent_interval_ms + elapsed) / 4);
+  }
+  this->_previous_direction = direction;
+
+  for (uint8_t i = 0; i < this->_curve_length; i++) {
+    if (this->_detent_interval_ms < this->_curve[i].max_detent_interval_ms) {
+      return detents * this->_curve[i].volume_steps;
+    }
+  }
+  return detents;
+}
+
+uint16_t Volume_Accelerator::get_detent_interval_ms(void) {
+  return this->_detent_interval_ms;
+}
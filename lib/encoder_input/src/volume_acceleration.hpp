@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Arduino.h>
+
+/* One point of an acceleration curve. Points must be sorted by interval */
+typedef struct {
+  uint16_t max_detent_interval_ms; // Detents arriving faster than this...
+  uint8_t  volume_steps;           // ...are worth this many volume steps each
+} Acceleration_Point_t;
+
+/**
+ * Turns encoder detents into volume steps based on how quickly the knob is
+ * being turned. Anything slower than the last curve point stays 1:1.
+ */
+class Volume_Accelerator {
+public:
+  void    init_volume_accelerator(const Acceleration_Point_t *curve,
+                                  uint8_t                     curve_length);
+  int16_t on_rotation(int16_t detents, uint32_t timestamp_ms);
+
+  uint16_t get_detent_interval_ms(void);
+
+private:
+  const Acceleration_Point_t *_curve        = nullptr;
+  uint8_t                     _curve_length = 0;
+
+  uint32_t _previous_timestamp_ms = 0;
+  uint16_t _detent_interval_ms    = UINT16_MAX;
+  int8_t   _previous_direction    = 0;
+};
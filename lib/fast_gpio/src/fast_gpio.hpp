@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+  digitalWrite()/digitalRead() look the pin up in the core's pin map and go
+  through a few layers of calls every time, ~50-70 cycles on the QingKe V4C.
+  These resolve to a single BSHR/BCR store or INDR load instead.
+*/
+
+/**
+ * A whole GPIO port known at compile time, e.g. for reading several encoder
+ * pins in one load.
+ */
+template <uint32_t PORT_BASE> struct Fast_GPIO_Port {
+  static inline GPIO_TypeDef *port(void) { return (GPIO_TypeDef *)PORT_BASE; }
+  static inline uint32_t      read(void) { return port()->INDR; }
+  static inline void set_mask(uint32_t mask) { port()->BSHR = mask; }
+  static inline void clear_mask(uint32_t mask) { port()->BCR = mask; }
+};
+
+/**
+ * A pin known at compile time, every access is a single register access to a
+ * constant address.
+ */
+template <uint32_t PORT_BASE, uint8_t BIT> struct Fast_GPIO {
+  static_assert(BIT < 16, "GPIO ports are 16 bits wide");
+  static constexpr uint32_t MASK = 1UL << BIT;
+
+  static inline void set(void) { Fast_GPIO_Port<PORT_BASE>::set_mask(MASK); }
+  static inline void clear(void) {
+    Fast_GPIO_Port<PORT_BASE>::clear_mask(MASK);
+  }
+  static inline void write(bool high) { high ? set() : clear(); }
+  static inline bool read(void) {
+    return Fast_GPIO_Port<PORT_BASE>::read() & MASK;
+  }
+};
+
+/**
+ * A pin that is only known at run time, such as the output pins handed to the
+ * SWC drivers. The port and mask are looked up once in init_gpio_pin(), after
+ * that it costs the same as Fast_GPIO plus a load of the port pointer.
+ */
+class GPIO_Pin {
+public:
+  void init_gpio_pin(int pin) {
+    this->_port = digitalPinToPort(pin);
+    this->_mask = digitalPinToBitMask(pin);
+  }
+  inline void set(void) { this->_port->BSHR = this->_mask; }
+  inline void clear(void) { this->_port->BCR = this->_mask; }
+  inline void write(bool high) { high ? this->set() : this->clear(); }
+  inline bool read(void) { return this->_port->INDR & this->_mask; }
+
+  GPIO_TypeDef *get_port(void) { return this->_port; }
+  uint32_t      get_mask(void) { return this->_mask; }
+
+private:
+  GPIO_TypeDef *_port = nullptr;
+  uint32_t      _mask = 0;
+};
@@ -2,18 +2,60 @@
 
 #include <Arduino.h>
 
-#define ALPINE_BIT_RESOLUTION_US  540
-#define ALPINE_ADDRESS            0x8672
-#define DELAY_BETWEEN_MESSAGES_MS 30
+#include "pulse_distance/pulse_distance_protocol.hpp"
 
-void Alpine_SWC::init_alpine_swc(int alpine_output_pin) {
-  _alpine_output_pin = alpine_output_pin;
+#define ALPINE_BIT_RESOLUTION_US 540
+#define ALPINE_ADDRESS           0x8672
+/* Held volume can be streamed as repeat frames, see
+ * protocol/MESSAGE_REPEAT.png. The headunit drops the held command if no
+ * repeat turns up in the window, so like Kenwood they are only sent when a
+ * timing profile sets a repeat gap */
+#define ALPINE_REPEAT_WINDOW_MS 100
+
+/* SOF, address MSB then LSB, command, inverted command */
+constexpr Pulse_Distance_Protocol_t alpine_protocol = {
+    .tick_us           = ALPINE_BIT_RESOLUTION_US,
+    .preamble_mark_us  = 9000,
+    .preamble_space_us = 4500,
+    .bit_mark_ticks    = 1,
+    .zero_space_ticks  = 1,
+    .one_space_ticks   = 3,
+    .address           = {ALPINE_ADDRESS >> 8, ALPINE_ADDRESS & 0xFF},
+    .address_length    = 2,
+    .invert_command    = true,
+    .stop_mark_ticks   = 1,
+    .gap_us            = ALPINE_BIT_RESOLUTION_US, // Then the profile's gap
+};
+
+/* Full frames only until repeats are known to work */
+constexpr SWC_Timing_Profile_t alpine_timing_profile = {
+    .hold_ms       = 0,
+    .long_hold_ms  = 0,
+    .gap_ms        = 30,
+    .repeat_gap_ms = 0,
+    .rate_per_s    = 0,
+    .burst         = 0,
+};
+
+typedef Pulse_Distance_Codec<alpine_protocol, ALPINE_MUTE, ALPINE_VOL_UP,
+                             ALPINE_VOL_DOWN, ALPINE_NEXT_TRACK,
+                             ALPINE_PREV_TRACK>
+    Alpine_Codec;
+
+void Alpine_SWC::init_alpine_swc(int           alpine_output_pin,
+                                 Pulse_Engine *pulse_engine) {
+  _alpine_output_pin  = alpine_output_pin;
+  _pulse_engine       = pulse_engine;
+  _alpine_output.init_gpio_pin(_alpine_output_pin);
   pinMode(_alpine_output_pin, OUTPUT);
   digitalWrite(_alpine_output_pin, LOW);
+  _repeat.init_nec_repeat(ALPINE_REPEAT_WINDOW_MS);
+  _timing = alpine_timing_profile;
 }
 
 void Alpine_SWC::on_encoder_rotation(bool cw_rotation) {
-  this->write_swc_command((cw_rotation) ? ALPINE_VOL_UP : ALPINE_VOL_DOWN);
+  this->write_swc_command((cw_rotation) ? ALPINE_VOL_UP : ALPINE_VOL_DOWN,
+                          true);
 }
 
 void Alpine_SWC::on_button_short_press(void) {
@@ -28,41 +70,41 @@ void Alpine_SWC::on_button_held(void) {
   this->write_swc_command(ALPINE_NEXT_TRACK);
 }
 
-void Alpine_SWC::write_swc_command(Alpine_Command_t command) {
-  /* Start with SOF */
-  digitalWrite(this->_alpine_output_pin, HIGH);
-  delay(9);
-  digitalWrite(this->_alpine_output_pin, LOW);
-  delayMicroseconds(4500);
-  /* Send the Address LSB first */
-  this->output_byte(ALPINE_ADDRESS >> 8);
-  this->output_byte(ALPINE_ADDRESS & 0xFF);
-  this->output_byte(command);
-  this->output_byte(~command);
-  digitalWrite(this->_alpine_output_pin, HIGH);
-  delayMicroseconds(ALPINE_BIT_RESOLUTION_US);
-  digitalWrite(this->_alpine_output_pin, LOW);
-  delayMicroseconds(ALPINE_BIT_RESOLUTION_US);
-  delay(DELAY_BETWEEN_MESSAGES_MS);
-}
+void Alpine_SWC::write_swc_command(Alpine_Command_t command,
+                                   bool             allow_repeat) {
+  /* The frame buffer is still being played out until the engine is idle */
+  this->_pulse_engine->wait_until_idle();
+  this->_frame.clear();
 
-void Alpine_SWC::output_byte(uint8_t data) {
-  for (uint8_t i = 0; i < 8; i++) {
-    (data & 1) ? alpine_binary_one() : alpine_binary_zero();
-    data = (data >> 1);
+  uint32_t now = millis();
+  /* Repeat frames are only sent once a profile gives them a gap */
+  allow_repeat = allow_repeat && this->_timing.repeat_gap_ms;
+  if (allow_repeat && this->_repeat.can_repeat(command, now)) {
+    /* Same volume command straight after the last one, ~3x faster */
+    NEC_Repeat::add_repeat_frame(&this->_frame, ALPINE_BIT_RESOLUTION_US,
+                                 this->_timing.repeat_gap_ms * 1000);
+    this->_repeat.on_frame_started(command, true, now,
+                                   this->_frame.get_duration_us());
+    this->_pulse_engine->play(&this->_alpine_output, &this->_frame);
+    return;
   }
-}
 
-void Alpine_SWC::alpine_binary_zero(void) {
-  digitalWrite(this->_alpine_output_pin, HIGH);
-  delayMicroseconds(ALPINE_BIT_RESOLUTION_US);
-  digitalWrite(this->_alpine_output_pin, LOW);
-  delayMicroseconds(ALPINE_BIT_RESOLUTION_US);
+  /* The whole frame comes straight out of the flash table */
+  const Pulse_Distance_Table_t<Alpine_Codec::FRAME_LENGTH> *table =
+      Alpine_Codec::find(command);
+  if (!table) {
+    return;
+  }
+  uint32_t gap_us = this->_timing.gap_ms * 1000UL;
+  if (allow_repeat) {
+    this->_repeat.on_frame_started(command, false, now,
+                                   table->duration_us + gap_us);
+  } else {
+    this->_repeat.reset();
+  }
+  this->_pulse_engine->play(&this->_alpine_output, table->durations,
+                            Alpine_Codec::FRAME_LENGTH, true, gap_us);
 }
 
-void Alpine_SWC::alpine_binary_one(void) {
-  digitalWrite(this->_alpine_output_pin, HIGH);
-  delayMicroseconds(ALPINE_BIT_RESOLUTION_US);
-  digitalWrite(this->_alpine_output_pin, LOW);
-  delayMicroseconds(3 * ALPINE_BIT_RESOLUTION_US);
-}
\ No newline at end of file
+/* The frame's trailing space and gap cover the wait for the next one */
+bool Alpine_SWC::is_ready(void) { return !this->_pulse_engine->is_busy(); }
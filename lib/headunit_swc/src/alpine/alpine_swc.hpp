@@ -1,6 +1,9 @@
 #pragma once
 
 #include "headunit_swc.hpp"
+#include <fast_gpio.hpp>
+#include "pulse_distance/nec_repeat.hpp"
+#include "pulse_distance/pulse_engine.hpp"
 
 typedef enum {
   ALPINE_MUTE       = 0x16,
@@ -12,17 +15,19 @@ typedef enum {
 
 class Alpine_SWC : public Headunit_SWC {
 public:
-  void init_alpine_swc(int alpine_output_pin);
+  void init_alpine_swc(int alpine_output_pin, Pulse_Engine *pulse_engine);
   void on_encoder_rotation(bool cw_rotation);
   void on_button_short_press(void);
   void on_button_double_press(void);
   void on_button_held(void);
+  bool is_ready(void);
 
 private:
-  int _alpine_output_pin;
+  int           _alpine_output_pin;
+  GPIO_Pin      _alpine_output;
+  Pulse_Engine *_pulse_engine;
+  Pulse_Frame   _frame;
+  NEC_Repeat    _repeat;
 
-  void write_swc_command(Alpine_Command_t command);
-  void output_byte(uint8_t data);
-  void alpine_binary_zero(void);
-  void alpine_binary_one(void);
+  void write_swc_command(Alpine_Command_t command, bool allow_repeat = false);
 };
\ No newline at end of file
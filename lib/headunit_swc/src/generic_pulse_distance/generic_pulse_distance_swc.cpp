@@ -0,0 +1,122 @@
+#include "generic_pulse_distance_swc.hpp"
+
+#include <Arduino.h>
+
+/* Same timings as the Kenwood driver */
+const Generic_Pulse_Distance_Config_t generic_pulse_distance_default_config = {
+    .tick_us           = 530,
+    .preamble_mark_us  = 9000,
+    .preamble_space_us = 4000,
+    .bit_mark_ticks    = 1,
+    .zero_space_ticks  = 1,
+    .one_space_ticks   = 3,
+    .address_length    = 2,
+    .address           = {0xB9, 0x46},
+    .invert_command    = 1,
+    .stop_mark_ticks   = 1,
+    .gap_us            = 5000,
+    .commands          = {0x14, 0x15, 0x16, 0x0B, 0x0A},
+};
+
+/* The config's own gap already spaces the frames out */
+constexpr SWC_Timing_Profile_t generic_pulse_distance_timing_profile = {
+    .hold_ms       = 0,
+    .long_hold_ms  = 0,
+    .gap_ms        = 0,
+    .repeat_gap_ms = 0,
+    .rate_per_s    = 0,
+    .burst         = 0,
+};
+
+/* Rejects anything that would overflow a duration or the frame buffer */
+bool Generic_Pulse_Distance_SWC::is_config_valid(
+    const Generic_Pulse_Distance_Config_t *config) {
+  if (!config || config->tick_us == 0 ||
+      config->address_length > PULSE_DISTANCE_MAX_ADDRESS_BYTES ||
+      config->invert_command > 1 || config->gap_us == 0) {
+    return false;
+  }
+  if (config->preamble_mark_us && config->preamble_space_us == 0) {
+    return false;
+  }
+  const uint8_t bit_ticks[] = {config->bit_mark_ticks,
+                               config->zero_space_ticks,
+                               config->one_space_ticks,
+                               config->stop_mark_ticks};
+  for (uint8_t ticks : bit_ticks) {
+    uint32_t duration_us = (uint32_t)ticks * config->tick_us;
+    if (duration_us == 0 || duration_us > UINT16_MAX) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Generic_Pulse_Distance_SWC::init_generic_pulse_distance_swc(
+    int gnd_en_pin, Pulse_Engine *pulse_engine,
+    const Generic_Pulse_Distance_Config_t *config) {
+  this->_gnd_en_pin   = gnd_en_pin;
+  this->_pulse_engine = pulse_engine;
+  this->_gnd_en.init_gpio_pin(this->_gnd_en_pin);
+  pinMode(this->_gnd_en_pin, OUTPUT);
+  digitalWrite(this->_gnd_en_pin, LOW);
+  this->_timing = generic_pulse_distance_timing_profile;
+
+  this->_configured = is_config_valid(config);
+  if (!this->_configured) {
+    return false;
+  }
+
+  Pulse_Distance_Protocol_t protocol = {
+      .tick_us           = config->tick_us,
+      .preamble_mark_us  = config->preamble_mark_us,
+      .preamble_space_us = config->preamble_space_us,
+      .bit_mark_ticks    = config->bit_mark_ticks,
+      .zero_space_ticks  = config->zero_space_ticks,
+      .one_space_ticks   = config->one_space_ticks,
+      .address           = {config->address[0], config->address[1]},
+      .address_length    = config->address_length,
+      .invert_command    = config->invert_command != 0,
+      .stop_mark_ticks   = config->stop_mark_ticks,
+      .gap_us            = config->gap_us,
+  };
+  this->_frame_length = pulse_distance_frame_length(protocol);
+  for (uint8_t i = 0; i < GENERIC_PULSE_DISTANCE_FUNCTION_COUNT; i++) {
+    this->_tables[i] =
+        make_pulse_distance_table<PULSE_DISTANCE_MAX_FRAME_LENGTH>(
+            protocol, config->commands[i]);
+  }
+  return true;
+}
+
+void Generic_Pulse_Distance_SWC::on_encoder_rotation(bool cw_rotation) {
+  this->_send((cw_rotation) ? GENERIC_PULSE_DISTANCE_VOLUME_UP
+                            : GENERIC_PULSE_DISTANCE_VOLUME_DOWN);
+}
+
+void Generic_Pulse_Distance_SWC::on_button_short_press(void) {
+  this->_send(GENERIC_PULSE_DISTANCE_MUTE);
+}
+
+void Generic_Pulse_Distance_SWC::on_button_double_press(void) {
+  this->_send(GENERIC_PULSE_DISTANCE_PREVIOUS_TRACK);
+}
+
+void Generic_Pulse_Distance_SWC::on_button_held(void) {
+  this->_send(GENERIC_PULSE_DISTANCE_NEXT_TRACK);
+}
+
+/* The frame's trailing space and gap cover the wait for the next one */
+bool Generic_Pulse_Distance_SWC::is_ready(void) {
+  return !this->_configured || !this->_pulse_engine->is_busy();
+}
+
+void Generic_Pulse_Distance_SWC::_send(
+    Generic_Pulse_Distance_Function_t function) {
+  if (!this->_configured) {
+    return;
+  }
+  this->_pulse_engine->play(
+      &this->_gnd_en, this->_tables[function].durations, this->_frame_length,
+      true, this->_timing.gap_ms * 1000UL);
+}
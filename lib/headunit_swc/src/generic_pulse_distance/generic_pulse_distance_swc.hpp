@@ -0,0 +1,69 @@
+#pragma once
+
+#include "headunit_swc.hpp"
+#include <fast_gpio.hpp>
+#include "pulse_distance/pulse_distance_protocol.hpp"
+#include "pulse_distance/pulse_engine.hpp"
+
+typedef enum {
+  GENERIC_PULSE_DISTANCE_VOLUME_UP,
+  GENERIC_PULSE_DISTANCE_VOLUME_DOWN,
+  GENERIC_PULSE_DISTANCE_MUTE,
+  GENERIC_PULSE_DISTANCE_NEXT_TRACK,
+  GENERIC_PULSE_DISTANCE_PREVIOUS_TRACK,
+  GENERIC_PULSE_DISTANCE_FUNCTION_COUNT,
+} Generic_Pulse_Distance_Function_t;
+
+/**
+ * Protocol and command codes as kept in the config record, multi-byte fields
+ * are little endian. See Pulse_Distance_Protocol_t for what each timing means.
+ */
+typedef struct __attribute__((packed)) {
+  uint16_t tick_us;
+  uint16_t preamble_mark_us; // 0 for no preamble
+  uint16_t preamble_space_us;
+  uint8_t  bit_mark_ticks;
+  uint8_t  zero_space_ticks;
+  uint8_t  one_space_ticks;
+  uint8_t  address_length;
+  uint8_t  address[PULSE_DISTANCE_MAX_ADDRESS_BYTES];
+  uint8_t  invert_command;
+  uint8_t  stop_mark_ticks;
+  uint16_t gap_us;
+  uint8_t  commands[GENERIC_PULSE_DISTANCE_FUNCTION_COUNT];
+} Generic_Pulse_Distance_Config_t;
+
+/* Used when nothing valid has been stored yet */
+extern const Generic_Pulse_Distance_Config_t
+    generic_pulse_distance_default_config;
+
+/**
+ * Any NEC-family headunit, described by a config loaded at boot. The edge
+ * table for each function is built once in init, after that sending is the
+ * same table hand-over to the Pulse_Engine the fixed brands use.
+ */
+class Generic_Pulse_Distance_SWC : public Headunit_SWC {
+public:
+  bool init_generic_pulse_distance_swc(
+      int gnd_en_pin, Pulse_Engine *pulse_engine,
+      const Generic_Pulse_Distance_Config_t *config);
+  void on_encoder_rotation(bool cw_rotation);
+  void on_button_short_press(void);
+  void on_button_double_press(void);
+  void on_button_held(void);
+  bool is_ready(void);
+
+  static bool is_config_valid(const Generic_Pulse_Distance_Config_t *config);
+
+private:
+  void _send(Generic_Pulse_Distance_Function_t function);
+
+  int           _gnd_en_pin;
+  GPIO_Pin      _gnd_en;
+  Pulse_Engine *_pulse_engine = nullptr;
+  bool          _configured   = false;
+  uint8_t       _frame_length = 0;
+
+  Pulse_Distance_Table_t<PULSE_DISTANCE_MAX_FRAME_LENGTH>
+      _tables[GENERIC_PULSE_DISTANCE_FUNCTION_COUNT];
+};
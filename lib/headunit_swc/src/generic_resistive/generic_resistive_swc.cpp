@@ -3,26 +3,61 @@
 #include <Arduino.h>
 #include <mcp4131.hpp>
 
-#define OUTPUT_DELAY_NOT_HELD_MS 80
-#define OUTPUT_DELAY_HELD        4000
-
 #define VOLUME_UP_RESISTANCE_OHMS      1000
 #define VOLUME_DOWN_RESISTANCE_OHMS    2000
 #define MUTE_RESISTANCE_OHMS           4000
 #define NEXT_TRACK_RESISTANCE_OHMS     6000
 #define PREVIOUS_TRACK_RESISTANCE_OHMS 8000
 
-#define BUTTON_SHORT_PRESS_RESISTANCE_OHMS NEXT_TRACK_RESISTANCE_OHMS
-#define BUTTON_HELD_RESISTANCE_OHMS        PREVIOUS_TRACK_RESISTANCE_OHMS
+#define BUTTON_SHORT_PRESS_FUNCTION RESISTIVE_NEXT_TRACK
+#define BUTTON_HELD_FUNCTION        RESISTIVE_PREVIOUS_TRACK
+
+/* A command is held long enough for an Android headunit to read it, or for
+ * much longer while it is learning a function */
+constexpr SWC_Timing_Profile_t generic_resistive_timing_profile = {
+    .hold_ms       = 80,
+    .long_hold_ms  = 4000,
+    .gap_ms        = 20,
+    .repeat_gap_ms = 0,
+    .rate_per_s    = 0,
+    .burst         = 0,
+};
+
+/* Functions the learning wizard walks through, in order. Mute has no
+ * gesture on this brand so it isn't taught */
+static constexpr Resistive_Function_t generic_resistive_learning_order[] = {
+    RESISTIVE_VOLUME_UP,
+    RESISTIVE_VOLUME_DOWN,
+    RESISTIVE_NEXT_TRACK,
+    RESISTIVE_PREVIOUS_TRACK,
+};
+#define LEARNING_STEP_COUNT                                                    \
+  (sizeof(generic_resistive_learning_order) /                                  \
+   sizeof(generic_resistive_learning_order[0]))
+
+static constexpr uint32_t
+    generic_resistive_resistances_ohms[RESISTIVE_FUNCTION_COUNT] = {
+        VOLUME_UP_RESISTANCE_OHMS,  VOLUME_DOWN_RESISTANCE_OHMS,
+        MUTE_RESISTANCE_OHMS,       NEXT_TRACK_RESISTANCE_OHMS,
+        PREVIOUS_TRACK_RESISTANCE_OHMS,
+};
+static constexpr Resistive_Table_t generic_resistive_nominal_table =
+    make_mcp4131_wiper_table(generic_resistive_resistances_ohms,
+                             mcp4131_nominal_calibration);
 
 void Generic_Resistive_SWC::init_generic_resistive_swc(MCP4131 *mcp4131_ptr,
                                                        int swc_gnd_en_pin) {
   if (mcp4131_ptr) {
-    this->_mcp4131 = mcp4131_ptr;
-    this->_mcp4131->set_output_resistance(0x00);
+    this->_mcp4131     = mcp4131_ptr;
+    this->_wiper_table = make_resistive_table(
+        mcp4131_ptr, generic_resistive_resistances_ohms,
+        generic_resistive_nominal_table);
+    this->_mcp4131->set_wiper(0x00);
     this->_swc_gnd_enable_pin = swc_gnd_en_pin;
     pinMode(this->_swc_gnd_enable_pin, OUTPUT);
     digitalWrite(this->_swc_gnd_enable_pin, LOW);
+    this->_swc_gnd_enable.init_gpio_pin(this->_swc_gnd_enable_pin);
+    this->_timing = generic_resistive_timing_profile;
   } else {
     while (1) {
       ;
@@ -31,57 +66,153 @@ void Generic_Resistive_SWC::init_generic_resistive_swc(MCP4131 *mcp4131_ptr,
 }
 
 void Generic_Resistive_SWC::on_encoder_rotation(bool clockwise_rotation) {
-  uint32_t required_resistance = (clockwise_rotation)
-                                     ? VOLUME_UP_RESISTANCE_OHMS
-                                     : VOLUME_DOWN_RESISTANCE_OHMS;
-  this->_mcp4131->set_output_resistance(required_resistance);
-  digitalWrite(this->_swc_gnd_enable_pin, HIGH);
-  if (this->_current_learning_mode_state == WAITING) {
-    delay(OUTPUT_DELAY_HELD);
-    this->_current_learning_mode_state = COMPLETE;
-  } else {
+  this->_send(clockwise_rotation ? RESISTIVE_VOLUME_UP
+                                 : RESISTIVE_VOLUME_DOWN);
+}
 
-    delay(OUTPUT_DELAY_NOT_HELD_MS);
-  }
-  digitalWrite(this->_swc_gnd_enable_pin, LOW);
+void Generic_Resistive_SWC::on_encoder_rotation_while_pressed(
+    bool clockwise_rotation) {
+  this->_send(clockwise_rotation ? RESISTIVE_NEXT_TRACK
+                                 : RESISTIVE_PREVIOUS_TRACK);
 }
 
 void Generic_Resistive_SWC::on_button_short_press(void) {
-  uint32_t required_resistance = BUTTON_SHORT_PRESS_RESISTANCE_OHMS;
-  this->_mcp4131->set_output_resistance(required_resistance);
-  digitalWrite(this->_swc_gnd_enable_pin, HIGH);
-  if (this->_current_learning_mode_state == WAITING) {
-    delay(OUTPUT_DELAY_HELD);
-    this->_current_learning_mode_state = COMPLETE;
-  } else {
-    delay(OUTPUT_DELAY_NOT_HELD_MS);
-  }
-  digitalWrite(this->_swc_gnd_enable_pin, LOW);
+  this->_send(BUTTON_SHORT_PRESS_FUNCTION);
 }
 
 void Generic_Resistive_SWC::on_button_double_press(void) {
-  this->_current_learning_mode_state = WAITING;
+  this->start_learning();
 }
 
-void Generic_Resistive_SWC::on_learning_mode_completed(void) {
-  this->_current_learning_mode_state = IDLE;
+void Generic_Resistive_SWC::on_button_held(void) {
+  this->_send(BUTTON_HELD_FUNCTION);
 }
 
-void Generic_Resistive_SWC::on_button_held(void) {
-  uint32_t required_resistance = BUTTON_HELD_RESISTANCE_OHMS;
-  this->_mcp4131->set_output_resistance(required_resistance);
-  digitalWrite(this->_swc_gnd_enable_pin, HIGH);
-  if (this->_current_learning_mode_state == WAITING) {
-    delay(OUTPUT_DELAY_HELD);
-    this->_current_learning_mode_state = COMPLETE;
-  } else {
-    delay(OUTPUT_DELAY_NOT_HELD_MS);
+/* Nothing else goes out while the wizard is running */
+bool Generic_Resistive_SWC::is_ready(void) {
+  return this->_output_state == SWC_OUTPUT_IDLE &&
+         this->_learning_state == LEARNING_IDLE;
+}
+
+/* Releases the output once it has been held long enough, then leaves it
+ * released for the gap */
+void Generic_Resistive_SWC::service(void) {
+  uint32_t now     = millis();
+  uint32_t elapsed = now - this->_output_timestamp;
+  if (this->_output_state == SWC_OUTPUT_ACTIVE &&
+      elapsed >= this->_output_hold_ms) {
+    this->_swc_gnd_enable.clear();
+    this->_output_state     = SWC_OUTPUT_SPACING;
+    this->_output_timestamp = now;
+    if (this->_learning_state == LEARNING_HOLDING) {
+      this->_set_learning_state(LEARNING_CONFIRM);
+    }
+  } else if (this->_output_state == SWC_OUTPUT_SPACING &&
+             elapsed >= this->_timing.gap_ms) {
+    this->_output_state = SWC_OUTPUT_IDLE;
+  }
+}
+
+/*
+The wizard walks through every function in one pass:
+  - PROMPT: put the headunit into learning for the function, then press once
+    to hold it on the output for the long hold time
+  - CONFIRM: press once if the headunit took it, double press to hold it
+    again, or hold the button to skip it
+A double press while prompted abandons the wizard and keeps the functions
+accepted last time.
+*/
+void Generic_Resistive_SWC::start_learning(void) {
+  this->_learning_step     = 0;
+  this->_learning_accepted = 0;
+  this->_set_learning_state(LEARNING_PROMPT);
+}
+
+void Generic_Resistive_SWC::on_learning_press(void) {
+  if (this->_learning_state == LEARNING_PROMPT &&
+      this->_output_state == SWC_OUTPUT_IDLE) {
+    this->_start_output(
+        generic_resistive_learning_order[this->_learning_step],
+        this->_timing.long_hold_ms);
+    this->_set_learning_state(LEARNING_HOLDING);
+  } else if (this->_learning_state == LEARNING_CONFIRM) {
+    this->_learning_accepted |=
+        1 << generic_resistive_learning_order[this->_learning_step];
+    this->_next_learning_step();
+  }
+}
+
+void Generic_Resistive_SWC::on_learning_double_press(void) {
+  if (this->_learning_state == LEARNING_PROMPT) {
+    this->_set_learning_state(LEARNING_IDLE);
+  } else if (this->_learning_state == LEARNING_CONFIRM) {
+    this->_set_learning_state(LEARNING_PROMPT);
+  }
+}
+
+void Generic_Resistive_SWC::on_learning_held(void) {
+  if (this->_learning_state == LEARNING_PROMPT ||
+      this->_learning_state == LEARNING_CONFIRM) {
+    this->_next_learning_step();
+  }
+}
+
+bool Generic_Resistive_SWC::is_learning(void) {
+  return this->_learning_state != LEARNING_IDLE;
+}
+
+Learning_State_t Generic_Resistive_SWC::get_learning_state(void) {
+  return this->_learning_state;
+}
+
+/* Index into the wizard's function order, from 0 */
+uint8_t Generic_Resistive_SWC::get_learning_step(void) {
+  return this->_learning_step;
+}
+
+/* When the wizard entered its current state, for the LED patterns */
+uint32_t Generic_Resistive_SWC::get_learning_timestamp(void) {
+  return this->_learning_timestamp;
+}
+
+/* One bit per Resistive_Function_t, set for the functions the headunit
+ * accepted the last time the wizard was completed */
+uint8_t Generic_Resistive_SWC::get_accepted_functions(void) {
+  return this->_accepted_functions;
+}
+
+void Generic_Resistive_SWC::set_accepted_functions(uint8_t accepted) {
+  this->_accepted_functions = accepted;
+}
+
+/* A function the headunit turned down would only be misread as another */
+void Generic_Resistive_SWC::_send(Resistive_Function_t function) {
+  if (this->_accepted_functions & (1 << function)) {
+    this->_start_output(function, this->_timing.hold_ms);
+  }
+}
+
+void Generic_Resistive_SWC::_start_output(Resistive_Function_t function,
+                                          uint32_t             hold_ms) {
+  this->_mcp4131->set_wiper(this->_wiper_table.codes[function]);
+  this->_swc_gnd_enable.set();
+  this->_output_hold_ms   = hold_ms;
+  this->_output_state     = SWC_OUTPUT_ACTIVE;
+  this->_output_timestamp = millis();
+}
+
+void Generic_Resistive_SWC::_next_learning_step(void) {
+  if (++this->_learning_step < LEARNING_STEP_COUNT) {
+    this->_set_learning_state(LEARNING_PROMPT);
+    return;
   }
-  digitalWrite(this->_swc_gnd_enable_pin, LOW);
+  this->_accepted_functions = this->_learning_accepted;
+  this->_set_learning_state(LEARNING_IDLE);
 }
 
-Learning_Mode_State_t Generic_Resistive_SWC::get_learning_mode_state(void) {
-  return (this->_current_learning_mode_state);
+void Generic_Resistive_SWC::_set_learning_state(Learning_State_t state) {
+  this->_learning_state     = state;
+  this->_learning_timestamp = millis();
 }
 
 void Generic_Resistive_SWC::run_loop_test(void) {
@@ -91,7 +222,7 @@ void Generic_Resistive_SWC::run_loop_test(void) {
          i < sizeof(required_resistances) / sizeof(required_resistances[0]);
          i++) {
       this->_mcp4131->set_output_resistance(required_resistances[i]);
-      digitalWrite(this->_swc_gnd_enable_pin, HIGH);
+      this->_swc_gnd_enable.set();
       delay(10000);
     }
   }
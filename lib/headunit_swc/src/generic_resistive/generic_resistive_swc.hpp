@@ -1,29 +1,64 @@
 #pragma once
 
 #include "headunit_swc.hpp"
+#include "resistive_table.hpp"
+#include <fast_gpio.hpp>
 #include <mcp4131.hpp>
 
+/* Every function accepted, what an unconfigured unit starts with */
+#define RESISTIVE_ALL_FUNCTIONS ((1 << RESISTIVE_FUNCTION_COUNT) - 1)
+
 typedef enum {
-  IDLE,
-  WAITING,
-  COMPLETE,
-} Learning_Mode_State_t;
+  LEARNING_IDLE,
+  LEARNING_PROMPT,  // Waiting for a press to send the current function
+  LEARNING_HOLDING, // Function held on the output for the headunit to learn
+  LEARNING_CONFIRM, // Waiting to hear whether the headunit took it
+} Learning_State_t;
 
 class Generic_Resistive_SWC : public Headunit_SWC {
 public:
   void init_generic_resistive_swc(MCP4131 *mcp4131_ptr, int swc_gnd_en_pin);
   void on_encoder_rotation(bool cw_rotation);
+  void on_encoder_rotation_while_pressed(bool cw_rotation);
   void on_button_short_press(void);
   void on_button_double_press(void);
   void on_button_held(void);
+  bool is_ready(void);
+  void service(void);
+
+  /* Learning wizard, button gestures go to these while is_learning() */
+  void start_learning(void);
+  void on_learning_press(void);
+  void on_learning_double_press(void);
+  void on_learning_held(void);
+
+  bool             is_learning(void);
+  Learning_State_t get_learning_state(void);
+  uint8_t          get_learning_step(void);
+  uint32_t         get_learning_timestamp(void);
 
-  Learning_Mode_State_t get_learning_mode_state(void);
-  void                  on_learning_mode_completed(void);
+  uint8_t get_accepted_functions(void);
+  void    set_accepted_functions(uint8_t accepted);
 
   void run_loop_test(void);
 
 private:
-  int                   _swc_gnd_enable_pin          = -1;
-  Learning_Mode_State_t _current_learning_mode_state = IDLE;
-  MCP4131              *_mcp4131;
+  void _send(Resistive_Function_t function);
+  void _start_output(Resistive_Function_t function, uint32_t hold_ms);
+  void _next_learning_step(void);
+  void _set_learning_state(Learning_State_t state);
+
+  int                _swc_gnd_enable_pin = -1;
+  GPIO_Pin           _swc_gnd_enable;
+  SWC_Output_State_t _output_state       = SWC_OUTPUT_IDLE;
+  uint32_t           _output_timestamp   = 0;
+  uint32_t           _output_hold_ms     = 0;
+  MCP4131           *_mcp4131;
+  Resistive_Table_t  _wiper_table;
+
+  Learning_State_t _learning_state     = LEARNING_IDLE;
+  uint8_t          _learning_step      = 0;
+  uint8_t          _learning_accepted  = 0; // Accepted so far this pass
+  uint32_t         _learning_timestamp = 0;
+  uint8_t          _accepted_functions = RESISTIVE_ALL_FUNCTIONS;
 };
\ No newline at end of file
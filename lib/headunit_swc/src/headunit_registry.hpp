@@ -0,0 +1,72 @@
+#pragma once
+
+#include <new>
+
+#include "headunit_swc.hpp"
+
+/* Brands this image has a driver for. Building with
+ * -D SINGLE_HEADUNIT_BRAND=HEADUNIT_KENWOOD leaves every other driver out */
+constexpr bool headunit_built_in(Headunit_Brand_t brand) {
+#ifdef SINGLE_HEADUNIT_BRAND
+  return brand == SINGLE_HEADUNIT_BRAND;
+#else
+  return brand >= HEADUNIT_GENERIC_RESISTIVE && brand < HEADUNIT_BRAND_ERROR;
+#endif
+}
+
+/* Builds the driver for one brand and hands it back, nullptr on failure */
+typedef Headunit_SWC *(*Headunit_Factory_t)(void);
+
+typedef struct {
+  Headunit_Brand_t   brand;
+  Headunit_Factory_t create; // nullptr when the brand isn't built in
+} Headunit_Registry_Entry_t;
+
+/* One entry of the Headunit_Storage typelist */
+template <Headunit_Brand_t BRAND, typename DRIVER> struct Headunit_Driver {
+  /* A driver left out of this build takes no space */
+  static constexpr size_t size = headunit_built_in(BRAND) ? sizeof(DRIVER) : 1;
+  static constexpr size_t alignment = alignof(DRIVER);
+};
+
+/* Closes a generated Headunit_Storage list, takes no space of its own */
+struct Headunit_List_End {
+  static constexpr size_t size      = 1;
+  static constexpr size_t alignment = 1;
+};
+
+constexpr size_t headunit_largest(size_t value) { return value; }
+
+template <typename... REST>
+constexpr size_t headunit_largest(size_t first, REST... rest) {
+  return first > headunit_largest(rest...) ? first : headunit_largest(rest...);
+}
+
+/**
+ * Room for exactly one headunit driver, sized for the largest one in the
+ * list that is built in. Only the brand selected at boot is ever constructed,
+ * into here, so the others cost neither RAM nor constructor time. The driver
+ * lives until reset and is never destroyed.
+ */
+template <typename... DRIVERS> class Headunit_Storage {
+public:
+  template <Headunit_Brand_t BRAND, typename DRIVER> DRIVER *emplace(void) {
+    static_assert(!headunit_built_in(BRAND) ||
+                      (sizeof(DRIVER) <= SIZE && alignof(DRIVER) <= ALIGNMENT),
+                  "Driver is missing from the Headunit_Storage list");
+    if constexpr (headunit_built_in(BRAND)) {
+      if (!this->_constructed) {
+        this->_constructed = true;
+        return new (this->_storage) DRIVER();
+      }
+    }
+    return nullptr;
+  }
+
+private:
+  static constexpr size_t SIZE      = headunit_largest(DRIVERS::size...);
+  static constexpr size_t ALIGNMENT = headunit_largest(DRIVERS::alignment...);
+
+  alignas(ALIGNMENT) uint8_t _storage[SIZE];
+  bool _constructed = false;
+};
@@ -5,4 +5,34 @@ Headunit_SWC::~Headunit_SWC(void) = default;
 void Headunit_SWC::on_encoder_rotation(bool cw_rotation) {}
 void Headunit_SWC::on_button_short_press(void) {}
 void Headunit_SWC::on_button_double_press(void) {}
-void Headunit_SWC::on_button_held(void) {}
\ No newline at end of file
+void Headunit_SWC::on_button_held(void) {}
+
+/* Push-and-turn skips tracks. By default these map onto the same functions as
+ * held (next track) and double press (previous track) */
+void Headunit_SWC::on_encoder_rotation_while_pressed(bool cw_rotation) {
+  if (cw_rotation) {
+    this->on_button_held();
+  } else {
+    this->on_button_double_press();
+  }
+}
+bool Headunit_SWC::is_ready(void) { return true; }
+void Headunit_SWC::service(void) {}
+
+/* Replaces the brand's defaults, call after the driver's init */
+void Headunit_SWC::set_timing_profile(const SWC_Timing_Profile_t *profile) {
+  this->_timing = *profile;
+}
+
+const SWC_Timing_Profile_t *Headunit_SWC::get_timing_profile(void) {
+  return &this->_timing;
+}
+
+bool Headunit_SWC::is_timing_profile_valid(
+    const SWC_Timing_Profile_t *profile) {
+  return profile->hold_ms <= SWC_TIMING_MAX_HOLD_MS &&
+         profile->long_hold_ms <= SWC_TIMING_MAX_LONG_HOLD_MS &&
+         profile->gap_ms <= SWC_TIMING_MAX_GAP_MS &&
+         profile->repeat_gap_ms <= SWC_TIMING_MAX_REPEAT_GAP_MS &&
+         (profile->rate_per_s == 0 || profile->burst > 0);
+}
@@ -10,9 +10,38 @@ typedef enum {
   HEADUNIT_PIONEER, // Pioneer and Sony are configured the same
   HEADUNIT_USB_HID,
   SWC_TESTING,
+  HEADUNIT_GENERIC_PULSE_DISTANCE, // Timings and commands from config
   HEADUNIT_BRAND_ERROR,
 } Headunit_Brand_t;
 
+/* Progress of a command that is held on the output for a set time */
+typedef enum {
+  SWC_OUTPUT_IDLE,
+  SWC_OUTPUT_ACTIVE,  // Output asserted
+  SWC_OUTPUT_SPACING, // Output released, waiting out the inter-frame gap
+} SWC_Output_State_t;
+
+/* Largest values a stored timing profile may hold */
+#define SWC_TIMING_MAX_HOLD_MS       10000
+#define SWC_TIMING_MAX_LONG_HOLD_MS  30000
+#define SWC_TIMING_MAX_GAP_MS        1000
+#define SWC_TIMING_MAX_REPEAT_GAP_MS 65 // Goes into a 16-bit us duration
+
+/**
+ * How fast a headunit can be driven. Each brand starts from its own defaults,
+ * a profile in the config record replaces them so one headunit can be tuned to
+ * its fastest reliable rate without a rebuild. Fields a brand has no use for
+ * are ignored, e.g. the pulse-distance brands don't hold their output.
+ */
+typedef struct __attribute__((packed)) {
+  uint16_t hold_ms;       // Resistive level held for this long
+  uint16_t long_hold_ms;  // Held instead while the headunit learns
+  uint16_t gap_ms;        // Output left idle after a command
+  uint16_t repeat_gap_ms; // Idle after an NEC repeat frame instead
+  uint8_t  rate_per_s;    // Commands per second on average, 0 for no limit
+  uint8_t  burst;         // Commands that may go out back to back
+} SWC_Timing_Profile_t;
+
 class Headunit_SWC {
 public:
   virtual ~Headunit_SWC(void);
@@ -20,4 +49,20 @@ public:
   virtual void on_button_short_press(void);
   virtual void on_button_double_press(void);
   virtual void on_button_held(void);
+  virtual void on_encoder_rotation_while_pressed(bool cw_rotation);
+
+  /* Commands are only handed over once the previous one has finished,
+   * including the brand's minimum gap before the next frame. service() is
+   * called every pass of loop() to move a command in progress along */
+  virtual bool is_ready(void);
+  virtual void service(void);
+
+  void set_timing_profile(const SWC_Timing_Profile_t *profile);
+
+  const SWC_Timing_Profile_t *get_timing_profile(void);
+
+  static bool is_timing_profile_valid(const SWC_Timing_Profile_t *profile);
+
+protected:
+  SWC_Timing_Profile_t _timing = {}; // Set to the brand's defaults in init
 };
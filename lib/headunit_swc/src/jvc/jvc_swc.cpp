@@ -8,6 +8,8 @@
 
 #include "jvc_swc.hpp"
 
+#include "pulse_distance/pulse_distance_protocol.hpp"
+
 #define JVC_DEVICE_ADDRESS                0x8F
 #define JVC_TICK_RESOLUTION_uS            530
 #define JVC_DATA_LENGTH_BITS              8
@@ -19,11 +21,50 @@
 #define JVC_MESSAGE_REPEAT_DELAY_MS       9
 #define JVC_MIN_SPACE_BETWEEN_WORDDS_MS   46
 #define JVC_MAX_SPACE_BETWEEN_WORDS_MS    60
+/* Start to start time of consecutive words while a command is held */
+#define JVC_WORD_PERIOD_MS (JVC_MIN_SPACE_BETWEEN_WORDDS_MS + 1)
+
+/* One word, address then command, finished by stop bit 1 and the
+ * transmission gap. The preamble only goes in front of a new command. The
+ * GND_EN output drives an open-drain stage, so a mark is written as HIGH */
+constexpr Pulse_Distance_Protocol_t jvc_word_protocol = {
+    .tick_us           = JVC_TICK_RESOLUTION_uS,
+    .preamble_mark_us  = 0,
+    .preamble_space_us = 0,
+    .bit_mark_ticks    = 1,
+    .zero_space_ticks  = 1,
+    .one_space_ticks   = 3,
+    .address           = {JVC_DEVICE_ADDRESS},
+    .address_length    = 1,
+    .invert_command    = false,
+    .stop_mark_ticks   = 1,
+    .gap_us =
+        JVC_TICK_RESOLUTION_uS * 3 + JVC_MESSAGE_TRANMISSION_GAP_MS * 1000,
+};
+
+/* The word period already spaces the words out, anything on top of it is
+ * extra time after the last word of a command */
+constexpr SWC_Timing_Profile_t jvc_timing_profile = {
+    .hold_ms       = 0,
+    .long_hold_ms  = 0,
+    .gap_ms        = 0,
+    .repeat_gap_ms = 0,
+    .rate_per_s    = 0,
+    .burst         = 0,
+};
 
-void JVC_SWC::init_jvc_swc(int gnd_en_pin) {
-  this->_gnd_en_pin = gnd_en_pin;
+typedef Pulse_Distance_Codec<jvc_word_protocol, JVC_VOLUME_UP_COMMAND,
+                             JVC_VOLUME_DOWN_COMMAND, JVC_MUTE_COMMAND,
+                             JVC_NEXT_TRACK, JVC_PREVIOUS_TRACK>
+    JVC_Codec;
+
+void JVC_SWC::init_jvc_swc(int gnd_en_pin, Pulse_Engine *pulse_engine) {
+  this->_gnd_en_pin   = gnd_en_pin;
+  this->_pulse_engine = pulse_engine;
+  this->_gnd_en.init_gpio_pin(this->_gnd_en_pin);
   pinMode(this->_gnd_en_pin, OUTPUT);
   digitalWrite(this->_gnd_en_pin, LOW);
+  this->_timing = jvc_timing_profile;
 }
 
 void JVC_SWC::on_encoder_rotation(bool cw_rotation) {
@@ -44,68 +85,56 @@ void JVC_SWC::on_button_double_press(void) {
 
 void JVC_SWC::on_button_held(void) { this->jvc_output_swc(JVC_NEXT_TRACK); }
 
+/*
+While commands keep arriving, the headunit sees one held button. Each word is
+padded out to the word period, so the next one can follow straight on and
+lands inside the 46-60 ms window the headunit expects for a held button.
+*/
 void JVC_SWC::jvc_output_swc(uint8_t swc_command) {
+  const Pulse_Distance_Table_t<JVC_Codec::FRAME_LENGTH> *word =
+      JVC_Codec::find(swc_command);
+  if (!word) {
+    return;
+  }
 
-  if (millis() - this->_previous_message_timestamp >= 60 ||
+  /* The frame buffer is still being played out until the engine is idle */
+  this->_pulse_engine->wait_until_idle();
+  this->_frame.clear();
+
+  /* Unsigned 32-bit difference, correct across the millis() wrap */
+  uint32_t now        = millis();
+  uint32_t elapsed_ms = now - this->_previous_word_timestamp;
+  if (elapsed_ms > JVC_MAX_SPACE_BETWEEN_WORDS_MS ||
       swc_command != this->_previous_command) {
-    /* Set timestamp to the start of the message */
-    this->_previous_message_timestamp = millis();
     /*
     The body of the message must be sent twice when it is a new command.
-    Older models require this to confirm the change of command. Send the command
-    now and wait to send the second command after
+    Older models require this to confirm the change of command. The second
+    word follows once the minimum word spacing has passed
     */
-    jvc_message_preamble();
-    write_byte_out(JVC_DEVICE_ADDRESS);
-    write_byte_out(swc_command);
-    jvc_message_postamble();
+    this->_frame.add_mark_space(JVC_PREAMBLE_AGC_PULSE_LENGTH_MS * 1000,
+                                JVC_PREAMBLE_LONG_PAUSE_LENGTH_MS * 1000);
+    this->_frame.add_durations(word->durations, JVC_Codec::FRAME_LENGTH);
+    this->_frame.pad_to_duration(JVC_WORD_PERIOD_MS * 1000UL);
+  } else {
+    /* Still held. Only waits if the last word was cut short */
+    this->_streamed_words++;
+    if (elapsed_ms < JVC_WORD_PERIOD_MS) {
+      this->_frame.add_lead_in((JVC_WORD_PERIOD_MS - elapsed_ms) * 1000UL);
+    }
   }
 
-  while (millis() - this->_previous_message_timestamp <=
-         JVC_MIN_SPACE_BETWEEN_WORDDS_MS) {
-    delay(1);
-  }
-  /* Set timestamp to the start of the message */
-  this->_previous_message_timestamp = millis();
-  write_byte_out(JVC_DEVICE_ADDRESS);
-  write_byte_out(swc_command);
-  jvc_message_postamble();
+  /* Set timestamp to the start of the last word */
+  uint32_t word_start_us         = this->_frame.get_duration_us();
+  this->_previous_word_timestamp = now + word_start_us / 1000;
+  this->_frame.add_durations(word->durations, JVC_Codec::FRAME_LENGTH);
+  this->_frame.pad_to_duration(word_start_us + JVC_WORD_PERIOD_MS * 1000UL);
   this->_previous_command = swc_command;
-}
 
-void JVC_SWC::write_byte_out(uint8_t output_byte) {
-  for (uint8_t i = 0; i < JVC_DATA_LENGTH_BITS; i++) {
-    (output_byte & 1) ? jvc_binary_one() : jvc_binary_zero();
-    output_byte = (output_byte >> 1);
-  }
+  this->_pulse_engine->play(&this->_gnd_en, &this->_frame,
+                            this->_timing.gap_ms * 1000UL);
 }
 
-/* Write a binary zero. We are controlling an open-drain output so we must
- * invert the signals */
-void JVC_SWC::jvc_binary_zero(void) {
-  digitalWrite(this->_gnd_en_pin, HIGH);
-  delayMicroseconds(JVC_TICK_RESOLUTION_uS);
-  digitalWrite(this->_gnd_en_pin, LOW);
-  delayMicroseconds(JVC_TICK_RESOLUTION_uS);
-}
-
-/* Write a binary one. We are controlling an open-drain output so we must
- * invert the signals */
-void JVC_SWC::jvc_binary_one(void) {
-  digitalWrite(this->_gnd_en_pin, HIGH);
-  delayMicroseconds(JVC_TICK_RESOLUTION_uS);
-  digitalWrite(this->_gnd_en_pin, LOW);
-  delayMicroseconds(JVC_TICK_RESOLUTION_uS * 3);
-}
-
-void JVC_SWC::jvc_message_preamble(void) {
-  digitalWrite(this->_gnd_en_pin, HIGH);
-  delay(JVC_PREAMBLE_AGC_PULSE_LENGTH_MS);
-  digitalWrite(this->_gnd_en_pin, LOW);
-  delay(JVC_PREAMBLE_LONG_PAUSE_LENGTH_MS);
-}
+uint32_t JVC_SWC::get_streamed_words(void) { return this->_streamed_words; }
 
-void JVC_SWC::jvc_message_postamble(void) {
-  jvc_binary_one(); // Stop bit 1
-  delay(JVC_MESSAGE_TRANMISSION_GAP_MS);
-}
\ No newline at end of file
+/* The frame's trailing space and gap cover the wait for the next one */
+bool JVC_SWC::is_ready(void) { return !this->_pulse_engine->is_busy(); }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "headunit_swc.hpp"
+#include <fast_gpio.hpp>
+#include "pulse_distance/pulse_engine.hpp"
 
 /*
 According to the protocol, all commands are sent LSB first so these enums
@@ -17,22 +19,23 @@ enum JVC_SWC_Command {
 
 class JVC_SWC : public Headunit_SWC {
 public:
-  void init_jvc_swc(int gnd_en_pin);
+  void init_jvc_swc(int gnd_en_pin, Pulse_Engine *pulse_engine);
   void on_encoder_rotation(bool cw_rotation);
   void on_button_short_press(void);
   void on_button_double_press(void);
   void on_button_held(void);
+  bool is_ready(void);
+
+  uint32_t get_streamed_words(void);
 
 private:
-  int      _gnd_en_pin;
-  uint8_t  _previous_command           = JVC_COMMAND_UNKNOWN;
-  uint16_t _previous_message_timestamp = 0;
-  uint16_t _current_message_timestamp  = 0;
+  int           _gnd_en_pin;
+  GPIO_Pin      _gnd_en;
+  Pulse_Engine *_pulse_engine;
+  Pulse_Frame   _frame;
+  uint8_t       _previous_command        = JVC_COMMAND_UNKNOWN;
+  uint32_t      _previous_word_timestamp = 0;
+  uint32_t      _streamed_words          = 0;
 
   void jvc_output_swc(uint8_t swc_command);
-  void write_byte_out(uint8_t output_byte);
-  void jvc_binary_zero(void);
-  void jvc_binary_one(void);
-  void jvc_message_preamble(void);
-  void jvc_message_postamble(void);
-};
\ No newline at end of file
+};
@@ -7,17 +7,20 @@
 #include "kenwood_swc.hpp"
 
 #include "headunit_swc.hpp"
+#include "pulse_distance/pulse_distance_protocol.hpp"
 
-#define KENWOOD_DATA_LENGTH_BITS 8
 /* Define the tick resolution in micro-seconds. This is the time required for a
  * single bit of data .. hard to explain, easier to show in the logic analyser
  * captures */
 #define KENWOOD_TICK_RESOLUTION_uS               530
 #define KENWOOD_SHORT_PULSE                      KENWOOD_TICK_RESOLUTION_uS
-#define KENWOOD_LONG_PULSE                       (KENWOOD_TICK_RESOLUTION_uS * 3)
 #define KENWOOD_PREAMBLE_LONG_PULSE_DURATION_mS  9
 #define KENWOOD_PREAMBLE_PULSE_PAUSE_DURATION_mS 4
-#define KENWOOD_MESSAGEdelay                     5
+/* Held volume can be streamed as NEC repeat frames, the headunit drops the
+ * held command if no repeat turns up in the window. Nothing captured so far
+ * shows a Kenwood unit taking them, so they are only sent when a timing
+ * profile sets a repeat gap */
+#define KENWOOD_REPEAT_WINDOW_MS 100
 
 #define KENWOOD_ADDRESS          0xB9
 #define KENWOOD_ADDRESS_INVERTED 0x46
@@ -31,19 +34,56 @@ enum Kenwood_SWC_Command {
   KENWOOD_MUTE           = 0x16,
 };
 
-void Kenwood_SWC::init_kenwood_swc(int gnd_control_pin) {
-  this->_gnd_control_pin = gnd_control_pin;
+/* Address, inverted address, command, inverted command */
+constexpr Pulse_Distance_Protocol_t kenwood_protocol = {
+    .tick_us           = KENWOOD_TICK_RESOLUTION_uS,
+    .preamble_mark_us  = KENWOOD_PREAMBLE_LONG_PULSE_DURATION_mS * 1000,
+    .preamble_space_us = KENWOOD_PREAMBLE_PULSE_PAUSE_DURATION_mS * 1000,
+    .bit_mark_ticks    = 1,
+    .zero_space_ticks  = 1,
+    .one_space_ticks   = 3,
+    .address           = {KENWOOD_ADDRESS, KENWOOD_ADDRESS_INVERTED},
+    .address_length    = 2,
+    .invert_command    = true,
+    .stop_mark_ticks   = 1,
+    .gap_us            = KENWOOD_SHORT_PULSE, // Then the profile's gap
+};
+
+/* Gaps between messages, the headunit doesn't hold or rate limit. Full frames
+ * only until repeats are known to work */
+constexpr SWC_Timing_Profile_t kenwood_timing_profile = {
+    .hold_ms       = 0,
+    .long_hold_ms  = 0,
+    .gap_ms        = 5,
+    .repeat_gap_ms = 0,
+    .rate_per_s    = 0,
+    .burst         = 0,
+};
+
+typedef Pulse_Distance_Codec<kenwood_protocol, KENWOOD_PREVIOUS_TRACK,
+                             KENWOOD_NEXT_TRACK, KENWOOD_PLAY_PAUSE,
+                             KENWOOD_VOLUME_UP, KENWOOD_VOLUME_DOWN,
+                             KENWOOD_MUTE>
+    Kenwood_Codec;
+
+void Kenwood_SWC::init_kenwood_swc(int           gnd_control_pin,
+                                   Pulse_Engine *pulse_engine) {
+  this->_gnd_control_pin  = gnd_control_pin;
+  this->_pulse_engine     = pulse_engine;
+  this->_gnd_control.init_gpio_pin(this->_gnd_control_pin);
   pinMode(this->_gnd_control_pin, OUTPUT);
   digitalWrite(this->_gnd_control_pin, LOW);
+  this->_repeat.init_nec_repeat(KENWOOD_REPEAT_WINDOW_MS);
+  this->_timing = kenwood_timing_profile;
 }
 
 void Kenwood_SWC::on_encoder_rotation(bool cw_rotation) {
   if (cw_rotation) {
-    this->kenwood_output_swc(KENWOOD_VOLUME_UP);
+    this->kenwood_output_swc(KENWOOD_VOLUME_UP, true);
   }
 
   else {
-    this->kenwood_output_swc(KENWOOD_VOLUME_DOWN);
+    this->kenwood_output_swc(KENWOOD_VOLUME_DOWN, true);
   }
 }
 
@@ -59,46 +99,39 @@ void Kenwood_SWC::on_button_held(void) {
   this->kenwood_output_swc(KENWOOD_NEXT_TRACK);
 }
 
-void Kenwood_SWC::kenwood_binary_one(void) {
-  digitalWrite(this->_gnd_control_pin, HIGH);
-  delayMicroseconds(KENWOOD_SHORT_PULSE);
-  digitalWrite(this->_gnd_control_pin, LOW);
-  delayMicroseconds(KENWOOD_LONG_PULSE);
-}
-
-void Kenwood_SWC::kenwood_binary_zero(void) {
-  digitalWrite(this->_gnd_control_pin, HIGH);
-  delayMicroseconds(KENWOOD_SHORT_PULSE);
-  digitalWrite(this->_gnd_control_pin, LOW);
-  delayMicroseconds(KENWOOD_SHORT_PULSE);
-}
-
-void Kenwood_SWC::kenwood_preamble(void) {
-  digitalWrite(this->_gnd_control_pin, HIGH);
-  delay(KENWOOD_PREAMBLE_LONG_PULSE_DURATION_mS);
-  digitalWrite(this->_gnd_control_pin, LOW);
-  delay(KENWOOD_PREAMBLE_PULSE_PAUSE_DURATION_mS);
-}
-
-void Kenwood_SWC::kenwood_postamble(void) {
-  digitalWrite(this->_gnd_control_pin, HIGH);
-  delayMicroseconds(KENWOOD_SHORT_PULSE);
-  digitalWrite(this->_gnd_control_pin, LOW);
-  delay(KENWOOD_MESSAGEdelay);
-}
+void Kenwood_SWC::kenwood_output_swc(uint8_t command, bool allow_repeat) {
+  /* The frame buffer is still being played out until the engine is idle */
+  this->_pulse_engine->wait_until_idle();
+  this->_frame.clear();
+
+  uint32_t now = millis();
+  allow_repeat = allow_repeat && this->_timing.repeat_gap_ms;
+  if (allow_repeat && this->_repeat.can_repeat(command, now)) {
+    /* Same volume command straight after the last one, send a repeat */
+    NEC_Repeat::add_repeat_frame(&this->_frame, KENWOOD_SHORT_PULSE,
+                                 this->_timing.repeat_gap_ms * 1000);
+    this->_repeat.on_frame_started(command, true, now,
+                                   this->_frame.get_duration_us());
+    this->_pulse_engine->play(&this->_gnd_control, &this->_frame);
+    return;
+  }
 
-void Kenwood_SWC::kenwood_output_byte(uint8_t data) {
-  for (uint8_t i = 0; i < 8; i++) {
-    (data & 1) ? kenwood_binary_one() : kenwood_binary_zero();
-    data = (data >> 1);
+  /* The whole frame comes straight out of the flash table */
+  const Pulse_Distance_Table_t<Kenwood_Codec::FRAME_LENGTH> *table =
+      Kenwood_Codec::find(command);
+  if (!table) {
+    return;
   }
+  uint32_t gap_us = this->_timing.gap_ms * 1000UL;
+  if (allow_repeat) {
+    this->_repeat.on_frame_started(command, false, now,
+                                   table->duration_us + gap_us);
+  } else {
+    this->_repeat.reset();
+  }
+  this->_pulse_engine->play(&this->_gnd_control, table->durations,
+                            Kenwood_Codec::FRAME_LENGTH, true, gap_us);
 }
 
-void Kenwood_SWC::kenwood_output_swc(uint8_t command) {
-  kenwood_preamble();
-  kenwood_output_byte(KENWOOD_ADDRESS);
-  kenwood_output_byte(KENWOOD_ADDRESS_INVERTED);
-  kenwood_output_byte(command);
-  kenwood_output_byte(~command);
-  kenwood_postamble();
-}
+/* The frame's trailing space and gap cover the wait for the next one */
+bool Kenwood_SWC::is_ready(void) { return !this->_pulse_engine->is_busy(); }
@@ -1,22 +1,25 @@
 #pragma once
 
+#include <fast_gpio.hpp>
 #include <headunit_swc.hpp>
+#include <pulse_distance/nec_repeat.hpp>
+#include <pulse_distance/pulse_engine.hpp>
 
 class Kenwood_SWC : public Headunit_SWC {
 public:
-  void init_kenwood_swc(int gnd_control_pin);
+  void init_kenwood_swc(int gnd_control_pin, Pulse_Engine *pulse_engine);
   void on_encoder_rotation(bool cw_rotation);
   void on_button_short_press(void);
   void on_button_double_press(void);
   void on_button_held(void);
+  bool is_ready(void);
 
 private:
-  void kenwood_binary_one(void);
-  void kenwood_binary_zero(void);
-  void kenwood_preamble(void);
-  void kenwood_postamble(void);
-  void kenwood_output_byte(uint8_t data);
-  void kenwood_output_swc(uint8_t command);
+  void kenwood_output_swc(uint8_t command, bool allow_repeat = false);
 
-  int _gnd_control_pin = -1;
+  int           _gnd_control_pin = -1;
+  GPIO_Pin      _gnd_control;
+  Pulse_Engine *_pulse_engine;
+  Pulse_Frame   _frame;
+  NEC_Repeat    _repeat;
 };
\ No newline at end of file
@@ -3,25 +3,47 @@
 #include <Arduino.h>
 #include <mcp4131.hpp>
 
-#define OUTPUT_DELAY_MS 50
-
 #define VOLUME_UP_RESISTANCE_OHMS      16000
 #define VOLUME_DOWN_RESISTANCE_OHMS    24000
 #define MUTE_RESISTANCE_OHMS           3500
 #define NEXT_TRACK_RESISTANCE_OHMS     8000
 #define PREVIOUS_TRACK_RESISTANCE_OHMS 11250
 
-#define BUTTON_SHORT_PRESS_RESISTANCE_OHMS  MUTE_RESISTANCE_OHMS
-#define BUTTON_HELD_RESISTANCE_OHMS         NEXT_TRACK_RESISTANCE_OHMS
-#define BUTTON_DOUBLE_PRESS_RESISTANCE_OHMS PREVIOUS_TRACK_RESISTANCE_OHMS
+#define BUTTON_SHORT_PRESS_FUNCTION  RESISTIVE_MUTE
+#define BUTTON_HELD_FUNCTION         RESISTIVE_NEXT_TRACK
+#define BUTTON_DOUBLE_PRESS_FUNCTION RESISTIVE_PREVIOUS_TRACK
+
+constexpr SWC_Timing_Profile_t pioneer_timing_profile = {
+    .hold_ms       = 50,
+    .long_hold_ms  = 0,
+    .gap_ms        = 50,
+    .repeat_gap_ms = 0,
+    .rate_per_s    = 0,
+    .burst         = 0,
+};
+
+/* Pioneer and Sony only accept a narrow band around each resistance, so the
+ * codes are recalculated for a calibrated pot */
+static constexpr uint32_t pioneer_resistances_ohms[RESISTIVE_FUNCTION_COUNT] = {
+    VOLUME_UP_RESISTANCE_OHMS,  VOLUME_DOWN_RESISTANCE_OHMS,
+    MUTE_RESISTANCE_OHMS,       NEXT_TRACK_RESISTANCE_OHMS,
+    PREVIOUS_TRACK_RESISTANCE_OHMS,
+};
+static constexpr Resistive_Table_t pioneer_nominal_table =
+    make_mcp4131_wiper_table(pioneer_resistances_ohms,
+                             mcp4131_nominal_calibration);
 
 void Pioneer_SWC::init_pioneer_swc(MCP4131 *mcp4131_ptr, int swc_gnd_en_pin) {
   if (mcp4131_ptr) {
-    this->_mcp4131 = mcp4131_ptr;
-    this->_mcp4131->set_output_resistance(0x00);
+    this->_mcp4131     = mcp4131_ptr;
+    this->_wiper_table = make_resistive_table(
+        mcp4131_ptr, pioneer_resistances_ohms, pioneer_nominal_table);
+    this->_mcp4131->set_wiper(0x00);
     this->_swc_gnd_enable_pin = swc_gnd_en_pin;
     pinMode(this->_swc_gnd_enable_pin, OUTPUT);
     digitalWrite(this->_swc_gnd_enable_pin, LOW);
+    this->_swc_gnd_enable.init_gpio_pin(this->_swc_gnd_enable_pin);
+    this->_timing = pioneer_timing_profile;
   } else {
     while (1) {
       ;
@@ -30,39 +52,45 @@ void Pioneer_SWC::init_pioneer_swc(MCP4131 *mcp4131_ptr, int swc_gnd_en_pin) {
 }
 
 void Pioneer_SWC::on_encoder_rotation(bool clockwise_rotation) {
-  uint32_t required_resistance = (clockwise_rotation)
-                                     ? VOLUME_UP_RESISTANCE_OHMS
-                                     : VOLUME_DOWN_RESISTANCE_OHMS;
-  this->_mcp4131->set_output_resistance(required_resistance);
-  digitalWrite(this->_swc_gnd_enable_pin, HIGH);
-  delay(OUTPUT_DELAY_MS);
-  digitalWrite(this->_swc_gnd_enable_pin, LOW);
-  delay(OUTPUT_DELAY_MS);
+  this->_start_output(clockwise_rotation ? RESISTIVE_VOLUME_UP
+                                         : RESISTIVE_VOLUME_DOWN);
 }
 
 void Pioneer_SWC::on_button_short_press(void) {
-  uint32_t required_resistance = BUTTON_SHORT_PRESS_RESISTANCE_OHMS;
-  this->_mcp4131->set_output_resistance(required_resistance);
-  digitalWrite(this->_swc_gnd_enable_pin, HIGH);
-  delay(OUTPUT_DELAY_MS);
-  digitalWrite(this->_swc_gnd_enable_pin, LOW);
-  delay(OUTPUT_DELAY_MS);
+  this->_start_output(BUTTON_SHORT_PRESS_FUNCTION);
 }
 
 void Pioneer_SWC::on_button_double_press(void) {
-  uint32_t required_resistance = BUTTON_DOUBLE_PRESS_RESISTANCE_OHMS;
-  this->_mcp4131->set_output_resistance(required_resistance);
-  digitalWrite(this->_swc_gnd_enable_pin, HIGH);
-  delay(OUTPUT_DELAY_MS);
-  digitalWrite(this->_swc_gnd_enable_pin, LOW);
-  delay(OUTPUT_DELAY_MS);
+  this->_start_output(BUTTON_DOUBLE_PRESS_FUNCTION);
 }
 
 void Pioneer_SWC::on_button_held(void) {
-  uint32_t required_resistance = BUTTON_HELD_RESISTANCE_OHMS;
-  this->_mcp4131->set_output_resistance(required_resistance);
-  digitalWrite(this->_swc_gnd_enable_pin, HIGH);
-  delay(OUTPUT_DELAY_MS);
-  digitalWrite(this->_swc_gnd_enable_pin, LOW);
-  delay(OUTPUT_DELAY_MS);
-}
\ No newline at end of file
+  this->_start_output(BUTTON_HELD_FUNCTION);
+}
+
+bool Pioneer_SWC::is_ready(void) {
+  return this->_output_state == SWC_OUTPUT_IDLE;
+}
+
+/* The output is held for the hold time, then left released for the gap
+ * before the next command */
+void Pioneer_SWC::service(void) {
+  uint32_t now     = millis();
+  uint32_t elapsed = now - this->_output_timestamp;
+  if (this->_output_state == SWC_OUTPUT_ACTIVE &&
+      elapsed >= this->_timing.hold_ms) {
+    this->_swc_gnd_enable.clear();
+    this->_output_state     = SWC_OUTPUT_SPACING;
+    this->_output_timestamp = now;
+  } else if (this->_output_state == SWC_OUTPUT_SPACING &&
+             elapsed >= this->_timing.gap_ms) {
+    this->_output_state = SWC_OUTPUT_IDLE;
+  }
+}
+
+void Pioneer_SWC::_start_output(Resistive_Function_t function) {
+  this->_mcp4131->set_wiper(this->_wiper_table.codes[function]);
+  this->_swc_gnd_enable.set();
+  this->_output_state     = SWC_OUTPUT_ACTIVE;
+  this->_output_timestamp = millis();
+}
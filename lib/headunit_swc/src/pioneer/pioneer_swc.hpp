@@ -1,6 +1,8 @@
 #pragma once
 
 #include "headunit_swc.hpp"
+#include "resistive_table.hpp"
+#include <fast_gpio.hpp>
 #include <mcp4131.hpp>
 
 class Pioneer_SWC : public Headunit_SWC {
@@ -10,9 +12,17 @@ public:
   void on_button_short_press(void);
   void on_button_double_press(void);
   void on_button_held(void);
+  bool is_ready(void);
+  void service(void);
 
 private:
-  int _swc_gnd_enable_pin = -1;
+  void _start_output(Resistive_Function_t function);
 
-  MCP4131 *_mcp4131;
+  int                _swc_gnd_enable_pin = -1;
+  GPIO_Pin           _swc_gnd_enable;
+  SWC_Output_State_t _output_state       = SWC_OUTPUT_IDLE;
+  uint32_t           _output_timestamp   = 0;
+
+  MCP4131          *_mcp4131;
+  Resistive_Table_t _wiper_table;
 };
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "nec_repeat.hpp"
+
+void NEC_Repeat::init_nec_repeat(uint32_t repeat_window_ms) {
+  this->_repeat_window_ms = repeat_window_ms;
+  this->reset();
+}
+
+/* The deadline is compared as a signed difference so millis() wrapping
+ * around doesn't matter */
+bool NEC_Repeat::can_repeat(uint8_t command, uint32_t now_ms) {
+  return this->_armed && command == this->_previous_command &&
+         (int32_t)(this->_repeat_deadline_ms - now_ms) >= 0;
+}
+
+/* Call for every frame, full or repeat, as it starts playing */
+void NEC_Repeat::on_frame_started(uint8_t command, bool repeat_frame,
+                                  uint32_t now_ms, uint32_t frame_duration_us) {
+  if (repeat_frame) {
+    this->_repeats_sent++;
+  }
+  this->_previous_command = command;
+  this->_repeat_deadline_ms =
+      now_ms + (frame_duration_us / 1000) + this->_repeat_window_ms;
+  this->_armed = true;
+}
+
+/* The next command has to go out as a full frame */
+void NEC_Repeat::reset(void) { this->_armed = false; }
+
+void NEC_Repeat::add_repeat_frame(Pulse_Frame *frame, uint16_t stop_mark_us,
+                                  uint16_t gap_us) {
+  frame->add_mark_space(NEC_REPEAT_AGC_MARK_US, NEC_REPEAT_SPACE_US);
+  frame->add_mark_space(stop_mark_us, gap_us);
+}
+
+uint32_t NEC_Repeat::get_repeats_sent(void) { return this->_repeats_sent; }
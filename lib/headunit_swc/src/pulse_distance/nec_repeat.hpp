@@ -0,0 +1,34 @@
+#pragma once
+
+#include "pulse_engine.hpp"
+
+/* NEC repeat frame, a short burst that means "same command again" */
+#define NEC_REPEAT_AGC_MARK_US 9000
+#define NEC_REPEAT_SPACE_US    2250
+
+/**
+ * Decides when a command can go out as a repeat frame instead of a full
+ * frame. A repeat is only valid for the same command, and only while the
+ * headunit still considers the previous frame held, i.e. the next frame must
+ * start within repeat_window_ms of the end of the previous one.
+ */
+class NEC_Repeat {
+public:
+  void init_nec_repeat(uint32_t repeat_window_ms);
+  bool can_repeat(uint8_t command, uint32_t now_ms);
+  void on_frame_started(uint8_t command, bool repeat_frame, uint32_t now_ms,
+                        uint32_t frame_duration_us);
+  void reset(void);
+
+  static void add_repeat_frame(Pulse_Frame *frame, uint16_t stop_mark_us,
+                               uint16_t gap_us);
+
+  uint32_t get_repeats_sent(void);
+
+private:
+  uint32_t _repeat_window_ms   = 0;
+  uint32_t _repeat_deadline_ms = 0;
+  uint8_t  _previous_command   = 0;
+  bool     _armed              = false;
+  uint32_t _repeats_sent       = 0;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define PULSE_DISTANCE_MAX_ADDRESS_BYTES 2
+
+/**
+ * Everything needed to encode a pulse-distance (NEC family) frame:
+ *
+ *   [preamble mark, preamble space] address bytes, command, [~command],
+ *   stop mark, gap
+ *
+ * Each bit is a fixed mark followed by a short (zero) or long (one) space,
+ * LSB first. Bit timings are in ticks, everything else in micro-seconds. The
+ * gap is the space after the stop mark, before the next frame may start.
+ */
+typedef struct {
+  uint16_t tick_us;
+  uint16_t preamble_mark_us; // 0 when the protocol has no preamble
+  uint16_t preamble_space_us;
+  uint8_t  bit_mark_ticks;
+  uint8_t  zero_space_ticks;
+  uint8_t  one_space_ticks;
+  uint8_t  address[PULSE_DISTANCE_MAX_ADDRESS_BYTES];
+  uint8_t  address_length;
+  bool     invert_command; // ~command follows the command
+  uint8_t  stop_mark_ticks;
+  uint16_t gap_us;
+} Pulse_Distance_Protocol_t;
+
+/* Mark/space durations in one frame, the same for every command */
+constexpr uint8_t
+pulse_distance_frame_length(const Pulse_Distance_Protocol_t &protocol) {
+  return (protocol.preamble_mark_us ? 2 : 0) +
+         (protocol.address_length + (protocol.invert_command ? 2 : 1)) * 16 +
+         2;
+}
+
+/* Preamble, two address bytes, command and inverted command, stop bit */
+#define PULSE_DISTANCE_MAX_FRAME_LENGTH                                        \
+  (2 + (PULSE_DISTANCE_MAX_ADDRESS_BYTES + 2) * 16 + 2)
+
+template <uint8_t LENGTH> struct Pulse_Distance_Table_t {
+  uint8_t  command;
+  uint32_t duration_us;
+  uint16_t durations[LENGTH]; // Alternating mark/space, starts with a mark
+};
+
+template <uint8_t LENGTH>
+constexpr void pulse_distance_add_byte(const Pulse_Distance_Protocol_t &protocol,
+                                       Pulse_Distance_Table_t<LENGTH>  &table,
+                                       uint8_t &index, uint8_t data) {
+  for (uint8_t bit = 0; bit < 8; bit++) {
+    table.durations[index++] = protocol.bit_mark_ticks * protocol.tick_us;
+    table.durations[index++] =
+        ((data >> bit) & 1) ? protocol.one_space_ticks * protocol.tick_us
+                            : protocol.zero_space_ticks * protocol.tick_us;
+  }
+}
+
+/* Builds the edge table for one command. Evaluated by the compiler for the
+ * fixed brands, LENGTH may be larger than the frame when built at run time */
+template <uint8_t LENGTH>
+constexpr Pulse_Distance_Table_t<LENGTH>
+make_pulse_distance_table(const Pulse_Distance_Protocol_t &protocol,
+                          uint8_t                          command) {
+  Pulse_Distance_Table_t<LENGTH> table = {};
+  uint8_t                        index = 0;
+  if (protocol.preamble_mark_us) {
+    table.durations[index++] = protocol.preamble_mark_us;
+    table.durations[index++] = protocol.preamble_space_us;
+  }
+  for (uint8_t i = 0; i < protocol.address_length; i++) {
+    pulse_distance_add_byte(protocol, table, index, protocol.address[i]);
+  }
+  pulse_distance_add_byte(protocol, table, index, command);
+  if (protocol.invert_command) {
+    pulse_distance_add_byte(protocol, table, index, (uint8_t)~command);
+  }
+  table.durations[index++] = protocol.stop_mark_ticks * protocol.tick_us;
+  table.durations[index++] = protocol.gap_us;
+
+  table.command = command;
+  for (uint8_t i = 0; i < LENGTH; i++) {
+    table.duration_us += table.durations[i];
+  }
+  return table;
+}
+
+/**
+ * The full edge tables for every command a brand sends, generated from its
+ * protocol descriptor at compile time and kept in flash. Sending a command is
+ * a lookup plus handing the table to the Pulse_Engine, nothing is encoded at
+ * run time. A new NEC-family brand only needs a descriptor and its command
+ * list.
+ */
+template <const Pulse_Distance_Protocol_t &PROTOCOL, uint8_t... COMMANDS>
+class Pulse_Distance_Codec {
+public:
+  static constexpr uint8_t FRAME_LENGTH = pulse_distance_frame_length(PROTOCOL);
+
+  /* Edge table for the command, nullptr if it isn't in the command list */
+  static const Pulse_Distance_Table_t<FRAME_LENGTH> *find(uint8_t command) {
+    for (const Pulse_Distance_Table_t<FRAME_LENGTH> &table : _tables) {
+      if (table.command == command) {
+        return &table;
+      }
+    }
+    return nullptr;
+  }
+
+private:
+  static constexpr Pulse_Distance_Table_t<FRAME_LENGTH> _tables[] = {
+      make_pulse_distance_table<FRAME_LENGTH>(PROTOCOL, COMMANDS)...};
+};
@@ -0,0 +1,184 @@
+#include "pulse_engine.hpp"
+
+/* The engine timer counts in micro-seconds */
+#define PULSE_ENGINE_TICK_HZ 1000000
+
+void Pulse_Frame::clear(void) {
+  this->_length           = 0;
+  this->_starts_with_mark = true;
+}
+
+void Pulse_Frame::add_lead_in(uint16_t space_us) {
+  if (this->_length == 0 && space_us > 0) {
+    this->_durations[this->_length++] = space_us;
+    this->_starts_with_mark           = false;
+  }
+}
+
+void Pulse_Frame::add_mark_space(uint16_t mark_us, uint16_t space_us) {
+  if (this->_length + 2 <= PULSE_FRAME_MAX_DURATIONS) {
+    this->_durations[this->_length++] = mark_us;
+    this->_durations[this->_length++] = space_us;
+  }
+}
+
+/* Appends mark/space pairs, e.g. a word from a Pulse_Distance_Codec table */
+void Pulse_Frame::add_durations(const uint16_t *durations, uint8_t length) {
+  for (uint8_t i = 0; i + 1 < length; i += 2) {
+    this->add_mark_space(durations[i], durations[i + 1]);
+  }
+}
+
+void Pulse_Frame::extend_last_space(uint16_t extra_space_us) {
+  if (this->_length) {
+    uint32_t space = this->_durations[this->_length - 1] + extra_space_us;
+    this->_durations[this->_length - 1] =
+        (space > UINT16_MAX) ? UINT16_MAX : (uint16_t)space;
+  }
+}
+
+/* Stretch the last space so the frame lasts at least total_us */
+void Pulse_Frame::pad_to_duration(uint32_t total_us) {
+  uint32_t duration = this->get_duration_us();
+  if (duration < total_us) {
+    this->extend_last_space(total_us - duration);
+  }
+}
+
+uint32_t Pulse_Frame::get_duration_us(void) {
+  uint32_t duration = 0;
+  for (uint8_t i = 0; i < this->_length; i++) {
+    duration += this->_durations[i];
+  }
+  return duration;
+}
+
+const uint16_t *Pulse_Frame::get_durations(void) { return this->_durations; }
+
+uint8_t Pulse_Frame::get_length(void) { return this->_length; }
+
+bool Pulse_Frame::starts_with_mark(void) { return this->_starts_with_mark; }
+
+void Pulse_Engine::init_pulse_engine(TIM_TypeDef *timer) {
+  this->_timer          = timer;
+  this->_hardware_timer = new HardwareTimer(timer);
+  this->_hardware_timer->setPrescaleFactor(SystemCoreClock /
+                                           PULSE_ENGINE_TICK_HZ);
+  this->_hardware_timer->attachInterrupt([this]() { this->on_timer_update(); });
+  /* Highest priority so USB and input interrupts can't stretch a pulse */
+  this->_hardware_timer->setInterruptPriority(0, 0);
+  /* Latch the prescaler now, then leave the timer stopped until play() */
+  this->_hardware_timer->resume();
+  this->_timer->CTLR1 &= ~TIM_CEN;
+  this->_timer->INTFR = (uint16_t)~TIM_UIF;
+}
+
+bool Pulse_Engine::play(GPIO_Pin *pin, Pulse_Frame *frame,
+                        uint32_t trailing_gap_us) {
+  return this->play(pin, frame->get_durations(), frame->get_length(),
+                    frame->starts_with_mark(), trailing_gap_us);
+}
+
+/* The trailing gap keeps the engine busy with the output released after the
+ * final space, so a frame from flash can still be followed by a gap that is
+ * only known at run time */
+bool Pulse_Engine::play(GPIO_Pin *pin, const uint16_t *durations,
+                        uint8_t length, bool starts_with_mark,
+                        uint32_t trailing_gap_us) {
+  if (this->_busy || length == 0) {
+    return false;
+  }
+  /* A zero period would be loaded as ATRLR = 0xFFFF, a 65 ms pulse */
+  for (uint8_t i = 0; i < length; i++) {
+    if (durations[i] == 0) {
+      return false;
+    }
+  }
+  this->_port             = pin->get_port();
+  this->_pin_mask         = pin->get_mask();
+  this->_durations        = durations;
+  this->_length           = length;
+  this->_starts_with_mark = starts_with_mark;
+  this->_gap_remaining_us = trailing_gap_us;
+  this->_end_index        = length;
+  this->_busy             = true;
+
+  /* Load the first period straight into the shadow register, then enable
+   * preload and queue up the second one */
+  this->_timer->CTLR1 &= ~(TIM_CEN | TIM_ARPE);
+  this->_timer->ATRLR = this->_durations[0] - 1;
+  this->_timer->CNT   = 0;
+  this->_timer->CTLR1 |= TIM_ARPE;
+  this->_preload(1);
+  this->_index        = 1;
+  this->_timer->INTFR = (uint16_t)~TIM_UIF;
+  this->_write_level(0);
+  this->_timer->DMAINTENR |= TIM_UIE;
+  this->_timer->CTLR1 |= TIM_CEN;
+  return true;
+}
+
+bool Pulse_Engine::is_busy(void) { return this->_busy; }
+
+void Pulse_Engine::wait_until_idle(void) {
+  while (this->_busy) {
+    ;
+  }
+}
+
+void Pulse_Engine::on_timer_update(void) {
+  if (!this->_busy) {
+    return;
+  }
+  uint16_t index = this->_index;
+  if (index >= this->_end_index) {
+    /* Final space and gap are over, the frame is done */
+    this->_timer->CTLR1 &= ~TIM_CEN;
+    this->_port->BCR = this->_pin_mask;
+    this->_frames_sent++;
+    this->_busy = false;
+    return;
+  }
+  if (index < this->_length) {
+    this->_write_level(index); // The output just stays released in the gap
+  }
+  this->_preload(index + 1);
+  this->_index = index + 1;
+}
+
+uint32_t Pulse_Engine::get_frames_sent(void) { return this->_frames_sent; }
+
+const uint16_t *Pulse_Engine::get_last_durations(void) {
+  return this->_durations;
+}
+
+uint8_t Pulse_Engine::get_last_length(void) { return this->_length; }
+
+bool Pulse_Engine::get_last_starts_with_mark(void) {
+  return this->_starts_with_mark;
+}
+
+/* Queues the period after the current one. Past the end of the frame the
+ * trailing gap goes in as chunks the 16-bit timer can count */
+void Pulse_Engine::_preload(uint16_t index) {
+  if (index < this->_length) {
+    this->_timer->ATRLR = this->_durations[index] - 1;
+  } else if (this->_gap_remaining_us) {
+    uint16_t chunk = (this->_gap_remaining_us > UINT16_MAX)
+                         ? UINT16_MAX
+                         : this->_gap_remaining_us;
+    this->_gap_remaining_us -= chunk;
+    this->_timer->ATRLR = chunk - 1;
+    this->_end_index++;
+  }
+}
+
+void Pulse_Engine::_write_level(uint8_t index) {
+  /* Even durations are marks when the frame starts with a mark */
+  bool mark = ((index & 1) == 0) == this->_starts_with_mark;
+  if (mark) {
+    this->_port->BSHR = this->_pin_mask;
+  } else {
+    this->_port->BCR = this->_pin_mask;
+  }
+}
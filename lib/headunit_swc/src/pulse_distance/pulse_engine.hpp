@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Arduino.h>
+#include <fast_gpio.hpp>
+
+/* Enough for a JVC double word or a 32-bit NEC style frame plus lead-in */
+#define PULSE_FRAME_MAX_DURATIONS 80
+
+/**
+ * Edge timings for one output frame. Durations alternate between mark (output
+ * driven HIGH) and space (LOW), optionally starting with a lead-in space. The
+ * last space doubles as the gap before the next frame may start.
+ */
+class Pulse_Frame {
+public:
+  void clear(void);
+  void add_lead_in(uint16_t space_us);
+  void add_mark_space(uint16_t mark_us, uint16_t space_us);
+  void add_durations(const uint16_t *durations, uint8_t length);
+  void extend_last_space(uint16_t extra_space_us);
+  void pad_to_duration(uint32_t total_us);
+
+  uint32_t        get_duration_us(void);
+  const uint16_t *get_durations(void);
+  uint8_t         get_length(void);
+  bool            starts_with_mark(void);
+
+private:
+  uint16_t _durations[PULSE_FRAME_MAX_DURATIONS];
+  uint8_t  _length           = 0;
+  bool     _starts_with_mark = true;
+};
+
+/**
+ * Plays a Pulse_Frame out on a GPIO from a hardware timer. Each timer period
+ * is one duration, the next one is preloaded into the auto-reload register so
+ * the period boundaries are exact. The update interrupt only has to flip the
+ * pin through BSHR/BCR. play() returns straight away, is_busy() drops once the
+ * final space and any trailing gap have elapsed. Durations can also come
+ * straight from a table in flash, they must stay valid until the engine is
+ * idle again. Frames holding a zero duration are refused.
+ */
+class Pulse_Engine {
+public:
+  void init_pulse_engine(TIM_TypeDef *timer);
+  bool play(GPIO_Pin *pin, Pulse_Frame *frame, uint32_t trailing_gap_us = 0);
+  bool play(GPIO_Pin *pin, const uint16_t *durations, uint8_t length,
+            bool starts_with_mark = true, uint32_t trailing_gap_us = 0);
+  bool is_busy(void);
+  void wait_until_idle(void);
+  void on_timer_update(void);
+
+  uint32_t get_frames_sent(void);
+
+  /* The frame most recently handed to play(), for the loopback self-test */
+  const uint16_t *get_last_durations(void);
+  uint8_t         get_last_length(void);
+  bool            get_last_starts_with_mark(void);
+
+private:
+  void _write_level(uint8_t index);
+  void _preload(uint16_t index);
+
+  TIM_TypeDef   *_timer;
+  HardwareTimer *_hardware_timer;
+
+  GPIO_TypeDef   *_port;
+  uint32_t        _pin_mask;
+  const uint16_t *_durations        = nullptr;
+  uint8_t         _length           = 0;
+  bool            _starts_with_mark = true;
+
+  uint32_t _gap_remaining_us = 0; // Trailing gap not yet queued
+  uint16_t _end_index        = 0; // Durations plus gap chunks queued so far
+
+  volatile uint16_t _index       = 0;
+  volatile bool     _busy        = false;
+  volatile uint32_t _frames_sent = 0;
+};
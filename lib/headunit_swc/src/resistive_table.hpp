@@ -0,0 +1,32 @@
+#pragma once
+
+#include <mcp4131.hpp>
+
+typedef enum {
+  RESISTIVE_VOLUME_UP,
+  RESISTIVE_VOLUME_DOWN,
+  RESISTIVE_MUTE,
+  RESISTIVE_NEXT_TRACK,
+  RESISTIVE_PREVIOUS_TRACK,
+  RESISTIVE_FUNCTION_COUNT,
+} Resistive_Function_t;
+
+/* Wiper code for each function, indexed by Resistive_Function_t */
+typedef MCP4131_Wiper_Table_t<RESISTIVE_FUNCTION_COUNT> Resistive_Table_t;
+
+/**
+ * The wiper table a resistive brand should use with this pot. Brands build
+ * their nominal table at compile time, it's only rebuilt here when the unit
+ * has a measured calibration. Either way, sending a function is then a
+ * single table load.
+ */
+inline Resistive_Table_t make_resistive_table(
+    MCP4131                 *mcp4131,
+    const uint32_t           (&resistances_ohms)[RESISTIVE_FUNCTION_COUNT],
+    const Resistive_Table_t &nominal_table) {
+  if (!mcp4131->is_calibrated()) {
+    return nominal_table;
+  }
+  return make_mcp4131_wiper_table(resistances_ohms,
+                                  mcp4131->get_calibration());
+}
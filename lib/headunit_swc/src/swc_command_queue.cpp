@@ -0,0 +1,187 @@
+#include "swc_command_queue.hpp"
+
+#define SWC_COMMAND_QUEUE_MASK (SWC_COMMAND_QUEUE_SIZE - 1)
+
+/* Tokens are counted in thousandths so a refill of rate_per_s per second is
+ * rate_per_s per millisecond */
+#define SWC_TOKEN_MILLI 1000
+
+static_assert((SWC_COMMAND_QUEUE_SIZE & SWC_COMMAND_QUEUE_MASK) == 0 &&
+                  SWC_COMMAND_QUEUE_SIZE <= 128,
+              "Queue size must be a power of two no larger than 128");
+
+/* True when one command undoes the other, only rotation works that way */
+static bool commands_cancel(SWC_Command_t a, SWC_Command_t b) {
+  switch (a) {
+  case SWC_COMMAND_ROTATION_CW:
+    return b == SWC_COMMAND_ROTATION_CCW;
+  case SWC_COMMAND_ROTATION_CCW:
+    return b == SWC_COMMAND_ROTATION_CW;
+  case SWC_COMMAND_ROTATION_WHILE_PRESSED_CW:
+    return b == SWC_COMMAND_ROTATION_WHILE_PRESSED_CCW;
+  case SWC_COMMAND_ROTATION_WHILE_PRESSED_CCW:
+    return b == SWC_COMMAND_ROTATION_WHILE_PRESSED_CW;
+  default:
+    return false;
+  }
+}
+
+void SWC_Command_Queue::init_swc_command_queue(Headunit_SWC *headunit) {
+  this->_headunit = headunit;
+  this->clear();
+  /* Start with a full bucket */
+  this->_tokens_milli    = UINT32_MAX;
+  this->_token_timestamp = millis();
+}
+
+bool SWC_Command_Queue::enqueue(SWC_Command_t command, uint8_t count) {
+  /* Fold the new command into the newest entry where we can */
+  while (count && this->_head != this->_tail) {
+    SWC_Command_Entry_t *newest =
+        &this->_entries[(uint8_t)(this->_head - 1) & SWC_COMMAND_QUEUE_MASK];
+    if (commands_cancel(newest->command, command)) {
+      uint8_t cancelled = min(count, newest->count);
+      newest->count -= cancelled;
+      count -= cancelled;
+      if (newest->count == 0) {
+        this->_head--;
+      }
+    } else if (newest->command == command && newest->count < UINT8_MAX) {
+      uint8_t merged = min(count, (uint8_t)(UINT8_MAX - newest->count));
+      newest->count += merged;
+      count -= merged;
+    } else {
+      break;
+    }
+  }
+  if (count == 0) {
+    return true;
+  }
+
+  if ((uint8_t)(this->_head - this->_tail) >= SWC_COMMAND_QUEUE_SIZE) {
+    this->_dropped_count += count;
+    return false;
+  }
+  SWC_Command_Entry_t *entry =
+      &this->_entries[this->_head & SWC_COMMAND_QUEUE_MASK];
+  entry->command = command;
+  entry->count   = count;
+  this->_head++;
+  return true;
+}
+
+void SWC_Command_Queue::service(void) {
+  if (!this->_headunit) {
+    this->clear();
+    return;
+  }
+  this->_headunit->service();
+  if (this->_head == this->_tail || !this->_headunit->is_ready() ||
+      !this->_take_token(millis())) {
+    return;
+  }
+
+  SWC_Command_Entry_t *entry =
+      &this->_entries[this->_tail & SWC_COMMAND_QUEUE_MASK];
+  SWC_Command_t command = entry->command;
+  if (--entry->count == 0) {
+    this->_tail++;
+  }
+  this->_dispatch(command);
+  this->_commands_sent++;
+}
+
+/* Nothing queued and nothing still going out */
+bool SWC_Command_Queue::is_idle(void) {
+  return this->_head == this->_tail &&
+         (!this->_headunit || this->_headunit->is_ready());
+}
+
+/* Commands queued and not handed to the headunit yet, one frame each */
+uint16_t SWC_Command_Queue::get_backlog(void) {
+  uint16_t backlog = 0;
+  for (uint8_t index = this->_tail; index != this->_head; index++) {
+    backlog += this->_entries[index & SWC_COMMAND_QUEUE_MASK].count;
+  }
+  return backlog;
+}
+
+void SWC_Command_Queue::clear(void) {
+  this->_head = 0;
+  this->_tail = 0;
+}
+
+uint32_t SWC_Command_Queue::get_dropped_count(void) {
+  return this->_dropped_count;
+}
+
+uint32_t SWC_Command_Queue::get_commands_sent(void) {
+  return this->_commands_sent;
+}
+
+/* Passes of service() where a ready headunit had to wait for a token */
+uint32_t SWC_Command_Queue::get_rate_limited_count(void) {
+  return this->_rate_limited_count;
+}
+
+bool SWC_Command_Queue::_take_token(uint32_t now) {
+  const SWC_Timing_Profile_t *timing = this->_headunit->get_timing_profile();
+  if (timing->rate_per_s == 0) {
+    return true;
+  }
+
+  uint32_t capacity      = timing->burst * SWC_TOKEN_MILLI;
+  uint32_t elapsed       = now - this->_token_timestamp;
+  this->_token_timestamp = now;
+  if (elapsed >= capacity || this->_tokens_milli >= capacity) {
+    /* Long enough to refill at any rate, and the sum can't overflow */
+    this->_tokens_milli = capacity;
+  } else {
+    this->_tokens_milli += elapsed * timing->rate_per_s;
+    if (this->_tokens_milli > capacity) {
+      this->_tokens_milli = capacity;
+    }
+  }
+
+  if (this->_tokens_milli < SWC_TOKEN_MILLI) {
+    this->_rate_limited_count++;
+    return false;
+  }
+  this->_tokens_milli -= SWC_TOKEN_MILLI;
+  return true;
+}
+
+void SWC_Command_Queue::_dispatch(SWC_Command_t command) {
+  switch (command) {
+  case SWC_COMMAND_ROTATION_CW:
+    this->_headunit->on_encoder_rotation(true);
+    break;
+
+  case SWC_COMMAND_ROTATION_CCW:
+    this->_headunit->on_encoder_rotation(false);
+    break;
+
+  case SWC_COMMAND_ROTATION_WHILE_PRESSED_CW:
+    this->_headunit->on_encoder_rotation_while_pressed(true);
+    break;
+
+  case SWC_COMMAND_ROTATION_WHILE_PRESSED_CCW:
+    this->_headunit->on_encoder_rotation_while_pressed(false);
+    break;
+
+  case SWC_COMMAND_SHORT_PRESS:
+    this->_headunit->on_button_short_press();
+    break;
+
+  case SWC_COMMAND_DOUBLE_PRESS:
+    this->_headunit->on_button_double_press();
+    break;
+
+  case SWC_COMMAND_HELD:
+    this->_headunit->on_button_held();
+    break;
+
+  default:
+    break;
+  }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "headunit_swc.hpp"
+
+/* Commands waiting to go out, must be a power of two */
+#define SWC_COMMAND_QUEUE_SIZE 16
+
+typedef enum : uint8_t {
+  SWC_COMMAND_ROTATION_CW,
+  SWC_COMMAND_ROTATION_CCW,
+  SWC_COMMAND_ROTATION_WHILE_PRESSED_CW,
+  SWC_COMMAND_ROTATION_WHILE_PRESSED_CCW,
+  SWC_COMMAND_SHORT_PRESS,
+  SWC_COMMAND_DOUBLE_PRESS,
+  SWC_COMMAND_HELD,
+} SWC_Command_t;
+
+typedef struct {
+  SWC_Command_t command;
+  uint8_t       count; // Times left to send this command
+} SWC_Command_Entry_t;
+
+/**
+ * Bounded queue of SWC commands and the transmitter that drains it. loop()
+ * enqueues commands and calls service() on every pass. A command is only
+ * handed to the headunit once is_ready() says the previous frame and its
+ * inter-frame gap are done, so nothing in here ever waits.
+ *
+ * Rotation in the same direction as the newest entry is merged into it, and
+ * rotation the other way takes steps back off it, so a quick spin back
+ * cancels volume steps that haven't been sent yet.
+ *
+ * The headunit's timing profile can also cap the command rate with a token
+ * bucket: tokens refill at rate_per_s up to burst, each command takes one.
+ */
+class SWC_Command_Queue {
+public:
+  void     init_swc_command_queue(Headunit_SWC *headunit);
+  bool     enqueue(SWC_Command_t command, uint8_t count = 1);
+  void     service(void);
+  bool     is_idle(void);
+  uint16_t get_backlog(void);
+  void     clear(void);
+
+  uint32_t get_dropped_count(void);
+  uint32_t get_commands_sent(void);
+  uint32_t get_rate_limited_count(void);
+
+private:
+  void _dispatch(SWC_Command_t command);
+  bool _take_token(uint32_t now);
+
+  Headunit_SWC       *_headunit = nullptr;
+  SWC_Command_Entry_t _entries[SWC_COMMAND_QUEUE_SIZE];
+  uint8_t             _head               = 0;
+  uint8_t             _tail               = 0;
+  uint32_t            _dropped_count      = 0;
+  uint32_t            _commands_sent      = 0;
+  uint32_t            _tokens_milli       = 0; // Thousandths of a command
+  uint32_t            _token_timestamp    = 0;
+  uint32_t            _rate_limited_count = 0;
+};
@@ -2,25 +2,31 @@
 
 #include <Arduino.h>
 
+/* Only built with the USB stack, see usb_hid_config.h */
+#ifdef USB_HID_BUILT_IN
+
+/* Captured mark/space widths must be this close to what was played */
+#define LOOPBACK_TOLERANCE_US 10
+/* A host that was plugged in when the test started has long enumerated by
+ * then, anything slower is treated as no host */
+#define USB_TEST_ENUMERATION_TIMEOUT_MS 2000
+/* Press and release take two 1 ms polls, allow for a busy host */
+#define USB_TEST_SEND_TIMEOUT_MS 100
+
 void Testing::init_testing(MCP4131 *mcp4131_ptr, int mcp4131_cs_pin,
                            int swc_gnd_en_pin, int alpine_in_out_pin,
-                           Alpine_SWC            *alpine_swc,
-                           Generic_Resistive_SWC *generic_resistive_swc,
-                           JVC_SWC *jvc_swc, Kenwood_SWC *kenwood_swc,
-                           Pioneer_SWC *pioneer_swc, USB_HID_SWC *usb_hid_swc) {
+                           Pulse_Engine  *pulse_engine,
+                           Timer_Capture *loopback_capture) {
   this->_mcp4131            = mcp4131_ptr;
   this->_mcp4131_cs_pin     = mcp4131_cs_pin;
   this->_swc_gnd_enable_pin = swc_gnd_en_pin;
   this->_alpine_in_out_pin  = alpine_in_out_pin;
-
-  this->_alpine_swc            = alpine_swc;
-  this->_generic_resistive_swc = generic_resistive_swc;
-  this->_jvc_swc               = jvc_swc;
-  this->_kenwood_swc           = kenwood_swc;
-  this->_pioneer_swc           = pioneer_swc;
-  this->_usb_hid_swc           = usb_hid_swc;
+  this->_pulse_engine       = pulse_engine;
+  this->_loopback_capture   = loopback_capture;
 
   this->_mcp4131->init(&SPI, this->_mcp4131_cs_pin);
+  /* Started now so the host has enumerated by the time the test runs */
+  this->_usb_hid_swc.init_usb_hid_swc();
 }
 
 void Testing::on_button_short_press(void) {
@@ -39,21 +45,147 @@ void Testing::on_encoder_rotation(bool cw_rotation) {}
 
 void Testing::on_button_double_press(void) {}
 
-void Testing::on_button_held(void) {}
+/* Held runs the loopback self-test, jumper the output under test to the
+ * capture input first */
+void Testing::on_button_held(void) { this->_run_loopback_self_test(); }
+
+/* The USB key release is still sent after the test sequence returns */
+bool Testing::is_ready(void) { return this->_usb_hid_swc.is_ready(); }
+
+void Testing::service(void) { this->_usb_hid_swc.service(); }
 
 void Testing::_test_alpine_output(void) {
-  this->_alpine_swc->init_alpine_swc(this->_alpine_in_out_pin);
-  this->_alpine_swc->on_encoder_rotation(true);
+  this->_alpine_swc.init_alpine_swc(this->_alpine_in_out_pin,
+                                    this->_pulse_engine);
+  this->_alpine_swc.on_encoder_rotation(true);
+  this->_pulse_engine->wait_until_idle();
 }
 
 void Testing::_test_kenwood_output(void) {
-  this->_kenwood_swc->init_kenwood_swc(this->_swc_gnd_enable_pin);
-  this->_kenwood_swc->on_encoder_rotation(true);
+  this->_kenwood_swc.init_kenwood_swc(this->_swc_gnd_enable_pin,
+                                      this->_pulse_engine);
+  this->_kenwood_swc.on_encoder_rotation(true);
+  this->_pulse_engine->wait_until_idle();
 }
 
 void Testing::_test_generic_resistance_output(void) { return; }
 
+USB_Test_Result_t Testing::get_usb_test_result(void) {
+  return this->_usb_test_result;
+}
+
+const Loopback_Result_t *
+Testing::get_loopback_result(Loopback_Brand_t brand) {
+  return (brand < LOOPBACK_BRAND_COUNT) ? &this->_loopback_results[brand]
+                                        : nullptr;
+}
+
+/*
+Plays one frame per brand and times every edge that comes back on the capture
+input. The widths are compared against the durations the pulse engine was
+given, so this checks the whole output path including ISR latency. Results
+are left in _loopback_results for the debugger.
+*/
+void Testing::_run_loopback_self_test(void) {
+  if (!this->_loopback_capture) {
+    return;
+  }
+  memset(this->_loopback_results, 0, sizeof(this->_loopback_results));
+
+  this->_jvc_swc.init_jvc_swc(this->_swc_gnd_enable_pin, this->_pulse_engine);
+  this->_loopback_capture->start();
+  this->_jvc_swc.on_encoder_rotation(true);
+  this->_capture_loopback(&this->_loopback_results[LOOPBACK_JVC]);
+
+  this->_kenwood_swc.init_kenwood_swc(this->_swc_gnd_enable_pin,
+                                      this->_pulse_engine);
+  this->_loopback_capture->start();
+  this->_kenwood_swc.on_encoder_rotation(true);
+  this->_capture_loopback(&this->_loopback_results[LOOPBACK_KENWOOD]);
+
+  /* Both outputs are jumpered to the capture input, only one may drive it */
+  pinMode(this->_swc_gnd_enable_pin, INPUT);
+  this->_alpine_swc.init_alpine_swc(this->_alpine_in_out_pin,
+                                    this->_pulse_engine);
+  this->_loopback_capture->start();
+  this->_alpine_swc.on_encoder_rotation(true);
+  this->_capture_loopback(&this->_loopback_results[LOOPBACK_ALPINE]);
+  pinMode(this->_alpine_in_out_pin, INPUT); // Make pin floating
+  pinMode(this->_swc_gnd_enable_pin, OUTPUT);
+  digitalWrite(this->_swc_gnd_enable_pin, LOW);
+}
+
+void Testing::_capture_loopback(Loopback_Result_t *result) {
+  const uint16_t *durations = this->_pulse_engine->get_last_durations();
+  uint8_t         length    = this->_pulse_engine->get_last_length();
+  /* A lead-in space has no edge in front of it, skip it */
+  uint8_t first = this->_pulse_engine->get_last_starts_with_mark() ? 0 : 1;
+  /* The final space has no edge after it, so it can't be measured */
+  result->widths_expected = (length > first + 1) ? length - first - 1 : 0;
+
+  uint32_t overcaptures = this->_loopback_capture->get_overcapture_count();
+  Capture_Edge_t edge;
+  uint16_t       previous_edge = 0;
+  uint8_t        edges         = 0;
+  bool           frame_playing = true;
+  while (frame_playing) {
+    /* Edges still waiting are collected once more after the frame ends */
+    frame_playing = this->_pulse_engine->is_busy();
+    while (this->_loopback_capture->poll(&edge)) {
+      if (edges > 0 && result->widths_measured < result->widths_expected) {
+        uint16_t width    = edge.timestamp - previous_edge;
+        uint16_t expected = durations[first + result->widths_measured];
+        uint16_t error =
+            (width > expected) ? width - expected : expected - width;
+        bool mark = !edge.rising; // A falling edge ends a mark
+        if (result->widths_measured == 0) {
+          result->first_mark_us = width;
+        } else if (result->widths_measured == 1) {
+          result->first_space_us = width;
+        }
+        if (mark && error > result->worst_mark_error_us) {
+          result->worst_mark_error_us = error;
+        } else if (!mark && error > result->worst_space_error_us) {
+          result->worst_space_error_us = error;
+        }
+        result->widths_measured++;
+      }
+      previous_edge = edge.timestamp;
+      edges++;
+    }
+  }
+  this->_loopback_capture->stop();
+
+  result->passed = result->widths_expected > 0 &&
+                   result->widths_measured == result->widths_expected &&
+                   result->worst_mark_error_us <= LOOPBACK_TOLERANCE_US &&
+                   result->worst_space_error_us <= LOOPBACK_TOLERANCE_US &&
+                   this->_loopback_capture->get_overcapture_count() ==
+                       overcaptures;
+}
+
+/* Reports sent before enumeration are dropped, so wait for a host and then
+ * for both reports to be read. Without a host the test is skipped */
 void Testing::_test_usb_output(void) {
-  this->_usb_hid_swc->init_usb_hid_swc();
-  this->_usb_hid_swc->on_encoder_rotation(true);
-}
\ No newline at end of file
+  uint32_t start_ms = millis();
+  while (!this->_usb_hid_swc.is_enumerated()) {
+    if (millis() - start_ms >= USB_TEST_ENUMERATION_TIMEOUT_MS) {
+      this->_usb_test_result = USB_TEST_NOT_ENUMERATED;
+      return;
+    }
+  }
+
+  uint32_t reports_before = this->_usb_hid_swc.get_report_count();
+  this->_usb_hid_swc.on_encoder_rotation(true);
+  start_ms = millis();
+  while (this->_usb_hid_swc.get_report_count() - reports_before < 2) {
+    if (millis() - start_ms >= USB_TEST_SEND_TIMEOUT_MS) {
+      this->_usb_test_result = USB_TEST_TIMED_OUT;
+      return;
+    }
+    this->_usb_hid_swc.service();
+  }
+  this->_usb_test_result = USB_TEST_PASSED;
+}
+
+#endif
@@ -2,43 +2,79 @@
 
 #include "headunit_swc.hpp"
 #include <mcp4131.hpp>
+#include <timer_capture.hpp>
 
 #include "alpine/alpine_swc.hpp"
-#include "generic_resistive/generic_resistive_swc.hpp"
 #include "jvc/jvc_swc.hpp"
 #include "kenwood/kenwood_swc.hpp"
-#include "pioneer/pioneer_swc.hpp"
+#include "pulse_distance/pulse_engine.hpp"
 #include "usb_hid/usb_hid_swc.hpp"
 
+/* Brands the loopback self-test plays a frame for */
+typedef enum {
+  LOOPBACK_JVC,
+  LOOPBACK_KENWOOD,
+  LOOPBACK_ALPINE,
+  LOOPBACK_BRAND_COUNT,
+} Loopback_Brand_t;
+
+/* What came back on the capture input for one brand's frame. Nothing
+ * captured means that brand's output isn't looped back */
+typedef struct {
+  uint8_t  widths_expected;
+  uint8_t  widths_measured;
+  uint16_t first_mark_us;
+  uint16_t first_space_us;
+  uint16_t worst_mark_error_us;
+  uint16_t worst_space_error_us;
+  bool     passed;
+} Loopback_Result_t;
+
+/* How the last USB output test went */
+typedef enum {
+  USB_TEST_NOT_RUN,
+  USB_TEST_PASSED,         // Press and release were both read by the host
+  USB_TEST_NOT_ENUMERATED, // Skipped, no host configured the device in time
+  USB_TEST_TIMED_OUT,      // Queued but the host never read both reports
+} USB_Test_Result_t;
+
 class Testing : public Headunit_SWC {
 public:
   void init_testing(MCP4131 *mcp4131_ptr, int mcp4131_cs_pin,
                     int swc_gnd_en_pin, int alpine_in_out_pin,
-                    Alpine_SWC            *alpine_swc,
-                    Generic_Resistive_SWC *generic_resistive_swc,
-                    JVC_SWC *jvc_swc, Kenwood_SWC *kenwood_swc,
-                    Pioneer_SWC *pioneer_swc, USB_HID_SWC *usb_hid_swc);
+                    Pulse_Engine  *pulse_engine,
+                    Timer_Capture *loopback_capture);
   void on_encoder_rotation(bool cw_rotation);
   void on_button_short_press(void);
   void on_button_double_press(void);
   void on_button_held(void);
+  bool is_ready(void);
+  void service(void);
+
+  const Loopback_Result_t *get_loopback_result(Loopback_Brand_t brand);
+  USB_Test_Result_t        get_usb_test_result(void);
 
 private:
   int _swc_gnd_enable_pin = -1;
   int _mcp4131_cs_pin     = -1;
   int _alpine_in_out_pin  = -1;
 
-  Alpine_SWC            *_alpine_swc;
-  Generic_Resistive_SWC *_generic_resistive_swc;
-  JVC_SWC               *_jvc_swc;
-  Kenwood_SWC           *_kenwood_swc;
-  Pioneer_SWC           *_pioneer_swc;
-  USB_HID_SWC           *_usb_hid_swc;
+  /* The brands under test, only ever built as part of this driver */
+  Alpine_SWC        _alpine_swc;
+  JVC_SWC           _jvc_swc;
+  Kenwood_SWC       _kenwood_swc;
+  USB_HID_SWC       _usb_hid_swc;
+  Pulse_Engine     *_pulse_engine;
+  Timer_Capture    *_loopback_capture;
+  Loopback_Result_t _loopback_results[LOOPBACK_BRAND_COUNT];
+  USB_Test_Result_t _usb_test_result = USB_TEST_NOT_RUN;
 
   void _test_alpine_output(void);
   void _test_kenwood_output(void);
   void _test_generic_resistance_output(void);
   void _test_usb_output(void);
+  void _run_loopback_self_test(void);
+  void _capture_loopback(Loopback_Result_t *result);
 
   MCP4131 *_mcp4131;
 };
\ No newline at end of file
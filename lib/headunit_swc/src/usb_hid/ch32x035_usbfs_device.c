@@ -13,6 +13,8 @@
 #include "ch32x035_usbfs_device.h"
 #include <Arduino.h>
 
+#ifdef USB_HID_BUILT_IN
+
 /*******************************************************************************/
 /* Variable Definition */
 
@@ -322,6 +324,16 @@ uint8_t USBFS_Endp_DataUp(uint8_t endp, uint8_t *pbuf, uint16_t len,
   return 0;
 }
 
+/*********************************************************************
+ * @fn      USBFS_EP1_IN_Complete
+ *
+ * @brief   Called from the interrupt once the host has read end-point 1,
+ *          override it to queue the next report straight away
+ *
+ * @return  none
+ */
+__attribute__((weak)) void USBFS_EP1_IN_Complete(void) {}
+
 /*********************************************************************
  * @fn      USBFS_IRQHandler
  *
@@ -380,6 +392,7 @@ void USBFS_IRQHandler(void) {
             (USBFSD->UEP1_CTRL_H & ~USBFS_UEP_T_RES_MASK) | USBFS_UEP_T_RES_NAK;
         USBFSD->UEP1_CTRL_H ^= USBFS_UEP_T_TOG;
         USBFS_Endp_Busy[DEF_UEP1] = 0;
+        USBFS_EP1_IN_Complete(); // Host took the report, load the next one
         break;
 
       /* end-point 2 data in interrupt */
@@ -830,3 +843,5 @@ void USBFS_Send_Resume(void) {
   GPIOC->CFGXR = (GPIOC->CFGXR & ~0x000000FF) | 0x00000084;
   GPIOC->BSXR  = 0x00010002;
 }
+
+#endif /* USB_HID_BUILT_IN */
@@ -109,6 +109,7 @@ extern void    MCU_Sleep_Wakeup_Operate(void);
 extern uint8_t USBFS_Endp_DataUp(uint8_t endp, uint8_t *pbuf, uint16_t len,
                                  uint8_t mod);
 extern void    USBFS_Send_Resume(void);
+extern void    USBFS_EP1_IN_Complete(void);
 
 #ifdef __cplusplus
 }
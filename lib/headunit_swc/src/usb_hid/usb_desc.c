@@ -15,6 +15,8 @@
 /* Header File */
 #include "usb_desc.h"
 
+#ifdef USB_HID_BUILT_IN
+
 /*******************************************************************************/
 /* Device Descriptor */
 const uint8_t MyDevDescr[] = {
@@ -80,7 +82,7 @@ const uint8_t MyCfgDescr[] = {
     0x03, // bmAttributes (Interrupt)
     0x02,
     0x00, // wMaxPacketSize
-    0x0A, // bInterval: 10mS
+    0x01, // bInterval: 1mS
 };
 
 /* Consumer Report Descriptor */
@@ -140,3 +142,5 @@ const uint8_t MyProdInfo[] = {0x12, 0x03, 'C', 0,   'H', 0,   '3', 0,   '2',
 const uint8_t MySerNumInfo[] = {0x16, 0x03, '0', 0, '1', 0, '2', 0,
                                 '3',  0,    '4', 0, '5', 0, '6', 0,
                                 '7',  0,    '8', 0, '9', 0};
+
+#endif /* USB_HID_BUILT_IN */
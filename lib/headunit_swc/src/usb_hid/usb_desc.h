@@ -19,6 +19,8 @@
 /*******************************************************************************/
 /* Macro Definition */
 
+#include "usb_hid_config.h"
+
 /* File Version */
 #define DEF_FILE_VERSION 0x01
 
@@ -0,0 +1,11 @@
+#ifndef __USB_HID_CONFIG_H
+#define __USB_HID_CONFIG_H
+
+/* The USB stack is left out of single-brand images unless they define this,
+ * see the slim environments in platformio.ini. The universal image always
+ * has it, for the USB HID brand and the testing harness */
+#if !defined(SINGLE_HEADUNIT_BRAND) && !defined(USB_HID_BUILT_IN)
+#define USB_HID_BUILT_IN
+#endif
+
+#endif
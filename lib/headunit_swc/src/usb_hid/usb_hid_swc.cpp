@@ -1,5 +1,12 @@
 #include "usb_hid_swc.hpp"
 #include "ch32x035_usbfs_device.h"
+#include "headunit_registry.hpp"
+
+#ifndef USB_HID_BUILT_IN
+static_assert(!headunit_built_in(HEADUNIT_USB_HID) &&
+                  !headunit_built_in(SWC_TESTING),
+              "This brand needs the USB stack, define USB_HID_BUILT_IN");
+#else
 
 #define USB_NEXT_TRACK_COMMAND     (1 << 0)
 #define USB_PREVIOUS_TRACK_COMMAND (1 << 1)
@@ -8,21 +15,48 @@
 #define USB_MUTE_COMMAND           (1 << 4)
 #define USB_VOLUME_UP_COMMAND      (1 << 5)
 #define USB_VOLUME_DOWN_COMMAND    (1 << 6)
-#define USB_NEW_PACKET_DELAY_MS    50
+
+static_assert(USB_HID_REPORT_QUEUE_SIZE >= 2 &&
+                  USB_HID_REPORT_QUEUE_SIZE <= 128 &&
+                  (USB_HID_REPORT_QUEUE_SIZE &
+                   (USB_HID_REPORT_QUEUE_SIZE - 1)) == 0,
+              "Report queue size must be a power of two no larger than 128");
+
+#define USB_HID_REPORT_ID 0x01
+
+/* The host paces the reports, a key is held for exactly one poll and there is
+ * no gap to wait out */
+constexpr SWC_Timing_Profile_t usb_hid_timing_profile = {
+    .hold_ms       = 0,
+    .long_hold_ms  = 0,
+    .gap_ms        = 0,
+    .repeat_gap_ms = 0,
+    .rate_per_s    = 0,
+    .burst         = 0,
+};
+
+/* Driver the end-point 1 interrupt hands back to */
+static USB_HID_SWC *usb_hid_active_swc = nullptr;
+
+extern "C" void USBFS_EP1_IN_Complete(void) {
+  if (usb_hid_active_swc) {
+    usb_hid_active_swc->on_report_sent();
+  }
+}
 
 void USB_HID_SWC::init_usb_hid_swc(void) {
+  usb_hid_active_swc = this;
   /* Usb Init */
   USBFS_RCC_Init();
   USBFS_Device_Init();
   USB_Sleep_Wakeup_CFG();
+  this->_timing = usb_hid_timing_profile;
 }
 
 void USB_HID_SWC::on_encoder_rotation(bool cw_rotation) {
-  if (USBFS_DevEnumStatus) {
-    uint8_t command =
-        (cw_rotation) ? USB_VOLUME_UP_COMMAND : USB_VOLUME_DOWN_COMMAND;
-    this->_send_keyboard_command(command);
-  }
+  uint8_t command =
+      (cw_rotation) ? USB_VOLUME_UP_COMMAND : USB_VOLUME_DOWN_COMMAND;
+  this->_send_keyboard_command(command);
 }
 
 void USB_HID_SWC::on_button_short_press() {
@@ -37,17 +71,76 @@ void USB_HID_SWC::on_button_double_press() {
   this->_send_keyboard_command(USB_PREVIOUS_TRACK_COMMAND);
 }
 
-void USB_HID_SWC::_send_keyboard_command(uint8_t command) {
-  memset(this->_KB_Data_Pack, 0x00, sizeof(this->_KB_Data_Pack));
-  this->_KB_Data_Pack[0] = 0x01; // Report ID is 0x01
-  this->_KB_Data_Pack[1] = command;
+/* Room for another press/release pair */
+bool USB_HID_SWC::is_ready(void) {
+  uint8_t used = this->_report_head.load(std::memory_order_relaxed) -
+                 this->_report_tail.load(std::memory_order_acquire);
+  return used <= USB_HID_REPORT_QUEUE_SIZE - 2;
+}
+
+/* The host has configured the device, reports queued now will be read */
+bool USB_HID_SWC::is_enumerated(void) { return USBFS_DevEnumStatus; }
+
+/* Kicks off a report if the end-point went idle with some queued, e.g. the
+ * first one after a quiet spell. Reports queued before enumeration or across
+ * a bus reset are thrown away, the host never asked for them */
+void USB_HID_SWC::service(void) {
+  NVIC_DisableIRQ(USBFS_IRQn);
   if (USBFS_DevEnumStatus) {
-    USBFS_Endp_DataUp(DEF_UEP1, this->_KB_Data_Pack,
-                      sizeof(this->_KB_Data_Pack), DEF_UEP_CPY_LOAD);
-    delay(10);                     // Allow 10ms for packet to be read
-    this->_KB_Data_Pack[1] = 0x00; // Reset key press list to nothing
-    USBFS_Endp_DataUp(DEF_UEP1, this->_KB_Data_Pack,
-                      sizeof(this->_KB_Data_Pack), DEF_UEP_CPY_LOAD);
+    this->_send_next_report();
+  } else {
+    uint8_t head = this->_report_head.load(std::memory_order_acquire);
+    uint8_t tail = this->_report_tail.load(std::memory_order_relaxed);
+    this->_dropped_report_count = this->_dropped_report_count + (head - tail);
+    this->_report_tail.store(head, std::memory_order_release);
+  }
+  NVIC_EnableIRQ(USBFS_IRQn);
+}
+
+/* Interrupt context, the host has read the last report */
+void USB_HID_SWC::on_report_sent(void) {
+  this->_report_count = this->_report_count + 1;
+  this->_send_next_report();
+}
+
+uint32_t USB_HID_SWC::get_report_count(void) { return this->_report_count; }
+
+uint32_t USB_HID_SWC::get_dropped_report_count(void) {
+  return this->_dropped_report_count;
+}
+
+/* Key press then key release, the release goes out on the next poll */
+void USB_HID_SWC::_send_keyboard_command(uint8_t command) {
+  if (!USBFS_DevEnumStatus || !this->is_ready()) {
+    this->_dropped_report_count = this->_dropped_report_count + 2;
+    return;
   }
-  delay(USB_NEW_PACKET_DELAY_MS);
+  this->_queue_report(command);
+  this->_queue_report(0x00); // Reset key press list to nothing
+  this->service();           // Start straight away if the end-point is idle
 }
+
+/* Producer side, only call from loop() once is_ready() has made room */
+void USB_HID_SWC::_queue_report(uint8_t keys) {
+  uint8_t head = this->_report_head.load(std::memory_order_relaxed);
+  this->_reports[head & (USB_HID_REPORT_QUEUE_SIZE - 1)] = keys;
+  this->_report_head.store(head + 1, std::memory_order_release);
+}
+
+/* Consumer side, call from the USB interrupt or with it masked. The report is
+ * copied into the end-point buffer so the slot is free once it is loaded */
+void USB_HID_SWC::_send_next_report(void) {
+  uint8_t tail = this->_report_tail.load(std::memory_order_relaxed);
+  if (USBFS_Endp_Busy[DEF_UEP1] ||
+      tail == this->_report_head.load(std::memory_order_acquire)) {
+    return;
+  }
+  uint8_t report[2] = {USB_HID_REPORT_ID,
+                       this->_reports[tail & (USB_HID_REPORT_QUEUE_SIZE - 1)]};
+  if (USBFS_Endp_DataUp(DEF_UEP1, report, sizeof(report), DEF_UEP_CPY_LOAD) ==
+      0) {
+    this->_report_tail.store(tail + 1, std::memory_order_release);
+  }
+}
+
+#endif
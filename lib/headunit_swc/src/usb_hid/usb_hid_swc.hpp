@@ -1,7 +1,22 @@
 #pragma once
 
+#include <atomic>
+
 #include "headunit_swc.hpp"
+#include "usb_hid_config.h"
+
+/* Reports waiting for the host, each command takes two (press and release).
+ * Power of two no larger than 128 */
+#define USB_HID_REPORT_QUEUE_SIZE 16
 
+/**
+ * Media keys over USB HID. Commands are queued as press/release report pairs
+ * and the end-point 1 IN-complete interrupt loads the next report as soon as
+ * the host has read the last one, so with a 1 ms polling interval a command
+ * takes two host polls and nothing waits on a timer. loop() is the only
+ * producer, the interrupt and service() (with the USB interrupt masked) are
+ * the consumers.
+ */
 class USB_HID_SWC : public Headunit_SWC {
 public:
   void init_usb_hid_swc(void);
@@ -9,8 +24,23 @@ public:
   void on_button_short_press(void);
   void on_button_double_press(void);
   void on_button_held(void);
+  bool is_ready(void);
+  bool is_enumerated(void);
+  void service(void);
+  void on_report_sent(void);
+
+  uint32_t get_report_count(void);
+  uint32_t get_dropped_report_count(void);
 
 private:
-  uint8_t _KB_Data_Pack[2] = {0x00}; // Media key report
-  void    _send_keyboard_command(uint8_t command);
-};
\ No newline at end of file
+  void _send_keyboard_command(uint8_t command);
+  void _queue_report(uint8_t keys);
+  void _send_next_report(void);
+
+  uint8_t              _reports[USB_HID_REPORT_QUEUE_SIZE]; // Key bitmaps
+  std::atomic<uint8_t> _report_head{0};
+  std::atomic<uint8_t> _report_tail{0};
+
+  volatile uint32_t _report_count         = 0;
+  volatile uint32_t _dropped_report_count = 0;
+};
@@ -1,57 +1,148 @@
 #include "mcp4131.hpp"
 
-#define WIPER_RESISTANCE        75
-#define FULL_SCALE_RESISTANCE   100000
-#define MCP4131_RESOLUTION_OHMS (FULL_SCALE_RESISTANCE / 128)
-
 #define TCON_R0B_BM  (1 << 0)
 #define TCON_R0W_BM  (1 << 1)
 #define TCON_R0A_BM  (1 << 2)
 #define TCON_R0HW_BM (1 << 3)
 
+#define MCP4131_DATA_MASK 0x1FF // D8:D0, D9 is unused on 7-bit parts
+
+/* The wiper goes straight to wiper_code, so the caller doesn't need a second
+ * verified write to move it off the power-up default */
+void MCP4131::init(SPIClass *spi_bus_ptr, int mcp4131_cs_pin,
+                   uint8_t wiper_code) {
+  this->_wiper_code = wiper_code;
+  this->init(spi_bus_ptr, mcp4131_cs_pin);
+}
+
 void MCP4131::init(SPIClass *spi_bus_ptr, int mcp4131_cs_pin) {
   this->_spi_bus_handle = spi_bus_ptr;
-  this->_cs_pin         = mcp4131_cs_pin;
-  pinMode(this->_cs_pin, OUTPUT);
-  digitalWrite(this->_cs_pin, HIGH);
-  this->_spi_bus_handle->begin(this->_cs_pin);
+  this->_cs.init_gpio_pin(mcp4131_cs_pin);
+  pinMode(mcp4131_cs_pin, OUTPUT);
+  this->_cs.set();
+  this->_spi_bus_handle->begin(mcp4131_cs_pin);
+
+  /* Put the pot in a known state so the cache can be trusted, then check
+   * whether it can be read back on this board */
+  this->_write_register(VOLATILE_TCON_REGISTER, this->_tcon_register_value);
+  this->_write_register(VOLATILE_WIPER_0, this->_wiper_code);
+  this->_readback_available = true; // Let verify() attempt the reads
+  this->_readback_available = this->verify();
 }
 
+/* Works the code out on every call, the SWC drivers use set_wiper() with a
+ * code from their wiper table instead */
 void MCP4131::set_output_resistance(uint32_t resistance_ohms) {
-  /* Calculate the required R_AB steps required */
-  uint8_t value = 0;
-  if (resistance_ohms > MCP4131_RESOLUTION_OHMS) {
-    value = (resistance_ohms - WIPER_RESISTANCE) / MCP4131_RESOLUTION_OHMS;
-  }
-  if (this->_current_resistance != value) {
-    _update_register(VOLATILE_WIPER_0, WRITE, value);
-    this->_current_resistance = value;
+  this->set_wiper(mcp4131_wiper_code(resistance_ohms, this->_calibration));
+}
+
+void MCP4131::set_wiper(uint8_t code) {
+  if (this->_wiper_code != code) {
+    this->_wiper_code = code;
+    this->_write_verified(VOLATILE_WIPER_0, code);
   }
 }
 
 void MCP4131::connect_wiper(void) {
-  this->_tcon_register_value |= TCON_R0W_BM;
-  this->_update_register(VOLATILE_TCON_REGISTER, WRITE, _tcon_register_value);
+  if (!(this->_tcon_register_value & TCON_R0W_BM)) {
+    this->_tcon_register_value |= TCON_R0W_BM;
+    this->_write_verified(VOLATILE_TCON_REGISTER, this->_tcon_register_value);
+  }
 }
 
 void MCP4131::disconnect_wiper(void) {
-  this->_tcon_register_value &= ~TCON_R0W_BM;
-  this->_update_register(VOLATILE_TCON_REGISTER, WRITE, _tcon_register_value);
+  if (this->_tcon_register_value & TCON_R0W_BM) {
+    this->_tcon_register_value &= ~TCON_R0W_BM;
+    this->_write_verified(VOLATILE_TCON_REGISTER, this->_tcon_register_value);
+  }
+}
+
+/* False when readback isn't available on this board */
+bool MCP4131::read_register(MCP4131_Register_Address_t address,
+                            uint16_t                  *value) {
+  if (!this->_readback_available) {
+    return false;
+  }
+  /* Data bits are sent high so the pot can drive the shared pin low */
+  *value = this->_transfer(address, READ, MCP4131_DATA_MASK,
+                           MCP4131_READ_SPI_HZ) &
+           MCP4131_DATA_MASK;
+  return true;
+}
+
+/* True when the wiper and TCON registers hold what the cache says */
+bool MCP4131::verify(void) {
+  uint16_t wiper;
+  uint16_t tcon;
+  if (!this->read_register(VOLATILE_WIPER_0, &wiper) ||
+      !this->read_register(VOLATILE_TCON_REGISTER, &tcon)) {
+    return false;
+  }
+  return wiper == this->_wiper_code &&
+         tcon == this->_tcon_register_value;
+}
+
+bool MCP4131::is_readback_available(void) {
+  return this->_readback_available;
+}
+
+uint32_t MCP4131::get_verify_error_count(void) {
+  return this->_verify_error_count;
+}
+
+/* Keeps the nominal values if the measured ones aren't plausible */
+bool MCP4131::set_calibration(MCP4131_Calibration_t calibration) {
+  if (calibration.full_scale_ohms < MCP4131_MIN_FULL_SCALE_OHMS ||
+      calibration.full_scale_ohms > MCP4131_MAX_FULL_SCALE_OHMS ||
+      calibration.wiper_ohms > MCP4131_MAX_WIPER_OHMS) {
+    this->_calibration = mcp4131_nominal_calibration;
+    return false;
+  }
+  this->_calibration = calibration;
+  return true;
+}
+
+const MCP4131_Calibration_t &MCP4131::get_calibration(void) {
+  return this->_calibration;
+}
+
+bool MCP4131::is_calibrated(void) {
+  const MCP4131_Calibration_t &nominal = mcp4131_nominal_calibration;
+  return this->_calibration.full_scale_ohms != nominal.full_scale_ohms ||
+         this->_calibration.wiper_ohms != nominal.wiper_ohms;
+}
+
+void MCP4131::_write_register(MCP4131_Register_Address_t address,
+                              uint16_t                   value) {
+  this->_transfer(address, WRITE, value, MCP4131_WRITE_SPI_HZ);
+}
+
+/* Writes, then reads back and rewrites once if the value didn't stick */
+void MCP4131::_write_verified(MCP4131_Register_Address_t address,
+                              uint16_t                   value) {
+  this->_write_register(address, value);
+
+  uint16_t readback;
+  if (!this->read_register(address, &readback) || readback == value) {
+    return;
+  }
+  this->_verify_error_count++;
+  this->_write_register(address, value);
 }
 
-void MCP4131::_update_register(MCP4131_Register_Address_t address,
-                               Command_t command, uint16_t value) {
+uint16_t MCP4131::_transfer(MCP4131_Register_Address_t address,
+                            Command_t command, uint16_t value,
+                            uint32_t clock_hz) {
   /* Mask all data fields with bit-size to ensure correct packet gen */
   uint16_t packet = ((uint8_t)address & 0b1111) << 12;
   packet |= ((uint8_t)command & 0b11) << 10;
-  packet |= (value & 0b111111111);
+  packet |= (value & 0b1111111111);
 
   this->_spi_bus_handle->beginTransaction(
-      SPISettings(250000, MSBFIRST, SPI_MODE0));
-  digitalWrite(this->_cs_pin, LOW);
-  delayMicroseconds(1);
-  this->_spi_bus_handle->transfer16(address);
-  this->_spi_bus_handle->transfer16(value);
+      SPISettings(clock_hz, MSBFIRST, SPI_MODE0));
+  this->_cs.clear();
+  uint16_t response = this->_spi_bus_handle->transfer16(packet);
+  this->_cs.set();
   this->_spi_bus_handle->endTransaction();
-  digitalWrite(this->_cs_pin, HIGH);
+  return response;
 }
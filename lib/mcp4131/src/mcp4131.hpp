@@ -1,6 +1,21 @@
 #pragma once
 
 #include <SPI.h>
+#include <fast_gpio.hpp>
+
+/* SDI/SDO is one shared pin, so reads must be clocked much slower */
+#define MCP4131_WRITE_SPI_HZ 10000000
+#define MCP4131_READ_SPI_HZ  250000
+
+/* Wiper codes run 0x00 (wiper at B) to 0x80 (full scale) */
+#define MCP4131_WIPER_STEPS         128
+#define MCP4131_POWER_UP_WIPER_CODE 0x40 // Mid-scale, 7-bit parts
+
+/* Calibration values outside these are treated as not calibrated, the part
+ * is specified to +/-20% on R_AB */
+#define MCP4131_MIN_FULL_SCALE_OHMS 80000
+#define MCP4131_MAX_FULL_SCALE_OHMS 120000
+#define MCP4131_MAX_WIPER_OHMS      325
 
 typedef enum {
   VOLATILE_WIPER_0,
@@ -25,25 +40,94 @@ typedef enum {
   READ,
 } Command_t;
 
+/**
+ * Per-unit calibration as measured between W and B: the resistance across
+ * the whole track (R_AB) and the wiper resistance at code 0x00. Stored in
+ * the config record as-is, little endian.
+ */
+typedef struct __attribute__((packed)) {
+  uint32_t full_scale_ohms;
+  uint16_t wiper_ohms;
+} MCP4131_Calibration_t;
+
+/* Datasheet values, used until a unit has been measured */
+constexpr MCP4131_Calibration_t mcp4131_nominal_calibration = {100000, 75};
+
+/* Closest wiper code for a W-B resistance */
+constexpr uint8_t
+mcp4131_wiper_code(uint32_t                     resistance_ohms,
+                   const MCP4131_Calibration_t &calibration) {
+  if (resistance_ohms <= calibration.wiper_ohms) {
+    return 0;
+  }
+  uint32_t code = ((resistance_ohms - calibration.wiper_ohms) *
+                       MCP4131_WIPER_STEPS +
+                   calibration.full_scale_ohms / 2) /
+                  calibration.full_scale_ohms;
+  return (code > MCP4131_WIPER_STEPS) ? MCP4131_WIPER_STEPS : code;
+}
+
+template <uint8_t LENGTH> struct MCP4131_Wiper_Table_t {
+  uint8_t codes[LENGTH];
+};
+
+/* Wiper code for each resistance. Evaluated by the compiler for the nominal
+ * calibration, and once at init for a measured one */
+template <uint8_t LENGTH>
+constexpr MCP4131_Wiper_Table_t<LENGTH>
+make_mcp4131_wiper_table(const uint32_t (&resistances_ohms)[LENGTH],
+                         const MCP4131_Calibration_t &calibration) {
+  MCP4131_Wiper_Table_t<LENGTH> table = {};
+  for (uint8_t i = 0; i < LENGTH; i++) {
+    table.codes[i] = mcp4131_wiper_code(resistances_ohms[i], calibration);
+  }
+  return table;
+}
+
+/**
+ * Driver for the MCP4131 digital potentiometer. Every command is a single
+ * 16-bit frame: address, command and 10 data bits. The wiper and TCON values
+ * are cached so writes that wouldn't change anything are skipped.
+ *
+ * The read command is clocked out over the shared SDI/SDO pin. If the first
+ * readback in init() matches what was written, every later write is read
+ * back as well and rewritten once on a mismatch. Boards where MISO isn't
+ * wired to the pot just skip the verification.
+ */
 class MCP4131 {
 public:
   void init(SPIClass *spi_bus_ptr, int mcp4131_cs_pin);
+  void init(SPIClass *spi_bus_ptr, int mcp4131_cs_pin, uint8_t wiper_code);
   void set_output_resistance(uint32_t resistance_ohms);
+  void set_wiper(uint8_t code);
   void connect_wiper(void);
   void disconnect_wiper(void);
 
+  bool read_register(MCP4131_Register_Address_t address, uint16_t *value);
+  bool verify(void);
+  bool is_readback_available(void);
+
+  uint32_t get_verify_error_count(void);
+
+  bool set_calibration(MCP4131_Calibration_t calibration);
+  bool is_calibrated(void);
+
+  const MCP4131_Calibration_t &get_calibration(void);
+
 private:
-  void _update_register(MCP4131_Register_Address_t address, Command_t command,
-                        uint16_t value);
+  void _write_register(MCP4131_Register_Address_t address, uint16_t value);
+  void _write_verified(MCP4131_Register_Address_t address, uint16_t value);
+  uint16_t _transfer(MCP4131_Register_Address_t address, Command_t command,
+                     uint16_t value, uint32_t clock_hz);
 
   SPIClass *_spi_bus_handle;
-  int       _cs_pin;
-  uint8_t   _current_resistance = 0x40; // Default at power-up for 7-bit devices
+  GPIO_Pin  _cs;
+  uint8_t   _wiper_code          = MCP4131_POWER_UP_WIPER_CODE;
   uint16_t  _tcon_register_value = 0x1FF; // Default at start-up
+  bool      _readback_available  = false;
+  uint32_t  _verify_error_count  = 0;
 
-  // Device properties
-  uint32_t _full_scale_resistance = 100000;
-  uint16_t _rs                    = _full_scale_resistance / 128;
+  MCP4131_Calibration_t _calibration = mcp4131_nominal_calibration;
 };
 
-extern MCP4131 mcp4131;
\ No newline at end of file
+extern MCP4131 mcp4131;
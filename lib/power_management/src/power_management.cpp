@@ -0,0 +1,110 @@
+#include "power_management.hpp"
+
+void Power_Manager::init_power_manager(GPIO_TypeDef      *wake_port,
+                                       uint32_t           wake_pin_mask,
+                                       uint32_t           stop_timeout_ms,
+                                       Power_Stop_Check_t inputs_idle) {
+  this->_wake_port        = wake_port;
+  this->_wake_pin_mask    = wake_pin_mask;
+  this->_stop_timeout_ms  = stop_timeout_ms;
+  this->_inputs_idle      = inputs_idle;
+  this->_last_activity_ms = millis();
+  this->_measure_start_us = micros();
+  RCC_APB1PeriphClockCmd(RCC_APB1Periph_PWR, ENABLE);
+}
+
+/* Turn off the clocks of peripherals the selected headunit never touches */
+void Power_Manager::gate_unused_peripherals(bool spi_in_use, bool usb_in_use) {
+  if (!spi_in_use) {
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_SPI1, DISABLE);
+  }
+  if (!usb_in_use) {
+    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_USBFS, DISABLE);
+  }
+  /* The USB stack handles its own suspend, don't pull the clock from under it
+   */
+  this->_stop_allowed_by_setup = !usb_in_use;
+}
+
+void Power_Manager::on_activity(uint32_t now_ms) {
+  this->_last_activity_ms = now_ms;
+}
+
+void Power_Manager::idle(uint32_t now_ms, bool allow_stop) {
+  if (allow_stop && this->_stop_allowed_by_setup &&
+      now_ms - this->_last_activity_ms >= this->_stop_timeout_ms) {
+    this->_enter_stop();
+    this->_last_activity_ms = millis();
+    return;
+  }
+
+  uint32_t sleep_start_us = micros();
+  __WFI();
+  this->_sleep_time_us += micros() - sleep_start_us;
+  if (this->_sleep_time_us >= 1000) {
+    this->_sleep_time_ms += this->_sleep_time_us / 1000;
+    this->_sleep_time_us %= 1000;
+  }
+}
+
+/* Wake events are set up on the registers directly. EXTI_Init() would clear
+ * the interrupt enables the EXTI input backend relies on */
+void Power_Manager::_configure_wake_events(FunctionalState state) {
+  if (state == ENABLE) {
+    uint8_t port_source = (this->_wake_port == GPIOA)   ? GPIO_PortSourceGPIOA
+                          : (this->_wake_port == GPIOB) ? GPIO_PortSourceGPIOB
+                                                        : GPIO_PortSourceGPIOC;
+    uint32_t pins = this->_wake_pin_mask;
+    while (pins) {
+      GPIO_EXTILineConfig(port_source, __builtin_ctz(pins));
+      pins &= pins - 1;
+    }
+    this->_saved_rising_triggers  = EXTI->RTENR & this->_wake_pin_mask;
+    this->_saved_falling_triggers = EXTI->FTENR & this->_wake_pin_mask;
+    EXTI->RTENR |= this->_wake_pin_mask;
+    EXTI->FTENR |= this->_wake_pin_mask;
+    EXTI->EVENR |= this->_wake_pin_mask;
+  } else {
+    EXTI->EVENR &= ~this->_wake_pin_mask;
+    EXTI->RTENR = (EXTI->RTENR & ~this->_wake_pin_mask) |
+                  this->_saved_rising_triggers;
+    EXTI->FTENR = (EXTI->FTENR & ~this->_wake_pin_mask) |
+                  this->_saved_falling_triggers;
+  }
+}
+
+void Power_Manager::_enter_stop(void) {
+  uint32_t pins_before = this->_wake_port->INDR & this->_wake_pin_mask;
+  this->_configure_wake_events(ENABLE);
+
+  __disable_irq();
+  /* A pin that moved before the wake events were armed would never wake us,
+   * so only stop if everything is where it was. Input the ISRs took in since
+   * loop() last looked, or are still filtering, would be stuck until the knob
+   * moves again, the timers are halted in STOP */
+  if ((this->_wake_port->INDR & this->_wake_pin_mask) == pins_before &&
+      (!this->_inputs_idle || this->_inputs_idle())) {
+    PWR_EnterSTOPMode(PWR_STOPEntry_WFE);
+    /* Back from STOP, set the clocks up again the way reset does */
+    SystemInit();
+    SystemCoreClockUpdate();
+    this->_stop_count++;
+  }
+  __enable_irq();
+
+  this->_configure_wake_events(DISABLE);
+}
+
+uint32_t Power_Manager::get_sleep_time_ms(void) { return this->_sleep_time_ms; }
+
+/* Time spent running since init, i.e. everything that wasn't WFI */
+uint32_t Power_Manager::get_awake_time_ms(void) {
+  uint32_t now_us = micros();
+  this->_measured_time_rem_us += now_us - this->_measure_start_us;
+  this->_measure_start_us = now_us;
+  this->_measured_time_ms += this->_measured_time_rem_us / 1000;
+  this->_measured_time_rem_us %= 1000;
+  return this->_measured_time_ms - this->_sleep_time_ms;
+}
+
+uint32_t Power_Manager::get_stop_count(void) { return this->_stop_count; }
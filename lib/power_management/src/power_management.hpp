@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Arduino.h>
+
+/* CH32 core source */
+#include <core_riscv_ch32yyxx.h>
+
+/* Called with interrupts masked right before STOP, false if input is still
+ * waiting to be handled and we have to stay awake */
+typedef bool (*Power_Stop_Check_t)(void);
+
+/**
+ * Idle handling for loop(). Short idles use WFI, which any interrupt
+ * (including the 1 ms SysTick) ends. Once the unit has been idle for
+ * stop_timeout_ms it drops into STOP mode until one of the wake pins changes,
+ * then restores the system clock the same way MCU_Sleep_Wakeup_Operate() does
+ * for USB suspend.
+ */
+class Power_Manager {
+public:
+  void init_power_manager(GPIO_TypeDef *wake_port, uint32_t wake_pin_mask,
+                          uint32_t           stop_timeout_ms,
+                          Power_Stop_Check_t inputs_idle);
+  void gate_unused_peripherals(bool spi_in_use, bool usb_in_use);
+  void on_activity(uint32_t now_ms);
+  void idle(uint32_t now_ms, bool allow_stop);
+
+  uint32_t get_sleep_time_ms(void);
+  uint32_t get_awake_time_ms(void);
+  uint32_t get_stop_count(void);
+
+private:
+  void _enter_stop(void);
+  void _configure_wake_events(FunctionalState state);
+
+  GPIO_TypeDef      *_wake_port;
+  uint32_t           _wake_pin_mask          = 0;
+  uint32_t           _stop_timeout_ms        = 0;
+  Power_Stop_Check_t _inputs_idle            = nullptr;
+  uint32_t           _last_activity_ms       = 0;
+  bool               _stop_allowed_by_setup  = true;
+  uint32_t           _saved_rising_triggers  = 0;
+  uint32_t           _saved_falling_triggers = 0;
+
+  /* Measurement, sleep covers time spent in WFI. STOP halts the clocks, so it
+   * can only be counted, not timed */
+  uint32_t _sleep_time_us        = 0;
+  uint32_t _sleep_time_ms        = 0;
+  uint32_t _measure_start_us     = 0;
+  uint32_t _measured_time_ms     = 0;
+  uint32_t _measured_time_rem_us = 0;
+  uint32_t _stop_count           = 0;
+};
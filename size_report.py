@@ -0,0 +1,20 @@
+import os
+import subprocess
+Import("env")
+
+
+def size_report(source, target, env):
+    elf_path = str(target[0])
+    output = subprocess.check_output(
+        [env.subst("$SIZETOOL"), "-B", "-d", elf_path], text=True
+    )
+    # Berkeley format: text, data, bss, dec, hex, filename
+    text, data, bss = [int(field) for field in output.splitlines()[1].split()[:3]]
+    report = f'{env["PIOENV"]}: flash {text + data} bytes, RAM {data + bss} bytes'
+    print(report)
+    report_path = os.path.join(env.subst("$BUILD_DIR"), "size_report.txt")
+    with open(report_path, "w") as f:
+        f.write(report + "\n")
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", size_report)
@@ -1,6 +1,19 @@
 #include <Arduino.h>
 #include <EEPROM.h>
+#include <button_gesture.hpp>
+#include <boot_profiler.hpp>
+#include <clock_calibration.hpp>
+#include <config_store.hpp>
+#include <encoder_timer.hpp>
+#include <fast_gpio.hpp>
+#include <input_event_ring.hpp>
+#include <input_filter.hpp>
+#include <isr_profiler.hpp>
 #include <mcp4131.hpp>
+#include <power_management.hpp>
+#include <quadrature_decoder.hpp>
+#include <timer_capture.hpp>
+#include <volume_acceleration.hpp>
 
 /* CH32 core source */
 #include <core_riscv_ch32yyxx.h>
@@ -10,23 +23,90 @@
 
 /* Now include all the headunit_swc headers for each brand */
 #include <alpine/alpine_swc.hpp>
+#include <generic_pulse_distance/generic_pulse_distance_swc.hpp>
 #include <generic_resistive/generic_resistive_swc.hpp>
+#include <headunit_registry.hpp>
 #include <jvc/jvc_swc.hpp>
 #include <kenwood/kenwood_swc.hpp>
 #include <pioneer/pioneer_swc.hpp>
+#include <pulse_distance/pulse_engine.hpp>
+#include <swc_command_queue.hpp>
 #include <testing/testing.hpp>
 #include <usb_hid/usb_hid_swc.hpp>
 
+/*
+  Encoder input backends, select with -D ENCODER_INPUT_BACKEND=... :
+    - EXTI: interrupt on every edge of PA1/PA2, decoded in software
+    - TIMER: counted by ENCODER_TIMER in encoder interface mode. The timer
+      only takes encoder inputs on CH1/CH2, so encoder B must be routed to
+      PA0 (TIM2_CH1) instead of PA2 on this backend
+    - SAMPLED: an edge on PA1/PA2/PA3 starts INPUT_SAMPLE_TIMER, which runs
+      all three through a lock-out filter before decoding and stops again
+      once they have settled, so contact bounce can't add steps
+*/
+#define ENCODER_INPUT_BACKEND_EXTI    0
+#define ENCODER_INPUT_BACKEND_TIMER   1
+#define ENCODER_INPUT_BACKEND_SAMPLED 2
+#ifndef ENCODER_INPUT_BACKEND
+#define ENCODER_INPUT_BACKEND ENCODER_INPUT_BACKEND_EXTI
+#endif
+
+#define ENCODER_TIMER              TIM2
+#define ENCODER_TIMER_INPUT_FILTER 0x0F // fDTS / 32, N = 8
+/* Encoder A lands on TI2 and B on TI1, so the count runs CCW-positive */
+#define ENCODER_TIMER_REVERSE_DIRECTION true
+
+/* Sampled backend. An edge is passed on straight away, then that pin is
+ * ignored for the lock-out window */
+#define INPUT_SAMPLE_TIMER TIM3
+#ifndef INPUT_SAMPLE_RATE_HZ
+#define INPUT_SAMPLE_RATE_HZ 4000
+#endif
+#ifndef INPUT_LOCKOUT_SAMPLES
+#define INPUT_LOCKOUT_SAMPLES 3 // 750 us at 4 kHz
+#endif
+
 /* Encoder Pins */
-#define PIN_INPUT_ENCODER_A  PA1
-#define PIN_INPUT_ENCODER_B  PA2
+#define PIN_INPUT_ENCODER_A PA1
+#if ENCODER_INPUT_BACKEND == ENCODER_INPUT_BACKEND_TIMER
+#define PIN_INPUT_ENCODER_B PA0
+#else
+#define PIN_INPUT_ENCODER_B PA2
+#endif
 #define PIN_INPUT_ENCODER_SW PA3
 
+/* Encoder pins as seen by the ISRs, which read the port register directly */
+#define ENCODER_GPIO_PORT_BASE GPIOA_BASE
+#define ENCODER_GPIO_PORT      GPIOA
+#define ENCODER_A_GPIO_BIT 1
+#if ENCODER_INPUT_BACKEND == ENCODER_INPUT_BACKEND_TIMER
+#define ENCODER_B_GPIO_BIT 0
+#else
+#define ENCODER_B_GPIO_BIT 2
+#endif
+#define ENCODER_SW_GPIO_BIT 3
+#define ENCODER_GPIO_MASK                                                      \
+  ((1 << ENCODER_A_GPIO_BIT) | (1 << ENCODER_B_GPIO_BIT) |                     \
+   (1 << ENCODER_SW_GPIO_BIT))
+
+/* Edges per reported detent, see quadrature_decoder.hpp */
+#ifndef ENCODER_RESOLUTION
+#define ENCODER_RESOLUTION ENCODER_RESOLUTION_1X
+#endif
+
 /* SWC Control Output */
 #define PIN_OUTPUT_SWC_GND_EN   PB3
 #define PIN_OUPUT_SWC_PUSH_PULL PB11
 
-#define STATUS_LED_PIN PC15
+/* Plays out the JVC, Kenwood and Alpine frames */
+#define PULSE_ENGINE_TIMER TIM1
+
+#define STATUS_LED_PIN            PC15
+#define STATUS_LED_GPIO_PORT_BASE GPIOC_BASE
+#define STATUS_LED_GPIO_BIT       15
+
+/* Writes timed by the optional digitalWrite vs. Fast_GPIO benchmark */
+#define FAST_GPIO_BENCHMARK_WRITES 100
 
 #define SPI_CHIP_SEL_PIN PA4
 
@@ -41,102 +121,293 @@
   VCC or GND using internal PU or PD to reduce idle power draw.
 */
 
-/* Encoder state flags */
-#define ENCODER_FLAG_ENCODER_BUTTON_SINGLE_PRESS_BM (1 << 0)
-#define ENCODER_FLAG_ENCODER_BUTTON_DOUBLE_PRESS_BM (1 << 1)
-#define ENCODER_FLAG_ENCODER_BUTTON_HELD_BM         (1 << 2)
-#define ENCODER_FLAG_BUTTON_TIMER_STARTED_BM        (1 << 3)
+/* Input events queued between the ISRs and loop(), must be a power of two */
+#define INPUT_EVENT_RING_SIZE 32
+
+/* Volume steps per detent vs. time between detents. Slower stays 1:1 */
+constexpr Acceleration_Point_t volume_acceleration_curve[] = {
+    {20, 4},
+    {40, 3},
+    {80, 2},
+};
+/* None of the protocols can carry more than one step per frame, so extra
+ * steps from the curve are only queued while fewer than this many commands
+ * are waiting to go out. Every detent still gets its one step */
+#define VOLUME_ACCELERATION_MAX_BACKLOG 4
+
+/* LED patterns while the generic resistive learning wizard runs: the step
+ * number blinked out then a pause while prompting, fast flashing while
+ * waiting for the press that confirms the headunit took the function */
+#define STATUS_LED_LEARNING_FLASH_MS 50
+#define STATUS_LED_PROMPT_BLINK_MS   200
+#define STATUS_LED_PROMPT_PAUSE_MS   1000
 
-/* Ceiling and floor for encoder rotation counts */
-#define MIN_ENCODER_COUNT -1
-#define MAX_ENCODER_COUNT 1
+/*
+  Clock calibration and the loopback self-test both capture on PA0 with
+  CAPTURE_TIMER, so neither is available on the TIMER encoder backend. A
+  CLOCK_REFERENCE_HZ square wave on PA0 at boot trims the HSI, the result is
+  kept in the config record and applied on every later boot
+*/
+#define CAPTURE_TIMER                TIM2
+#define CAPTURE_TICK_HZ              1000000
+#define CLOCK_REFERENCE_HZ           1000
+#define CLOCK_CALIBRATION_TIMEOUT_MS 25
+#define CLOCK_REFERENCE_DETECT_MS    3 // A couple of reference periods
+
+/* Idle time after which we drop from WFI into STOP until the knob moves */
+#define POWER_STOP_IDLE_TIMEOUT_MS 2000
 
 // Button state thresholds
 #define BUTTON_HELD_TIME_THRESHOLD_MS     500
 #define BUTTON_RELEASED_TIME_THRESHOLD_MS 1000
+#define BUTTON_DEBOUNCE_TIME_MS           20
+
+/*
+  The config record lives in a ring of flash pages below the EEPROM emulation
+  page, see config_store.hpp. board_upload.maximum_size in platformio.ini
+  keeps the firmware out of it. Changes are committed once they have been
+  left alone for CONFIG_COMMIT_DELAY_MS
+*/
+#define CONFIG_STORE_FLASH_ADDRESS 0x0800E800
+#define CONFIG_STORE_PAGES         8
+#define CONFIG_COMMIT_DELAY_MS     2000
+#define CONFIG_VERSION             1 // Bump when a field changes its layout
 
-/* EEPROM data addresses */
+#define HSI_TRIM_MARKER 0xA5 // hsi_trim_marker once a trim has been stored
+
+/* Older firmware kept the settings in the EEPROM emulation, the same layout
+ * as Config_t from EEPROM_ADDRESS_CONFIG on */
 #define EEPROM_ADDRESS_HEADER    0x00
 #define EEPROM_HEADER_SIZE_BYTES 4
-#define EEPROM_ADDRESS_HEADUNIT_BRAND                                          \
+#define EEPROM_ADDRESS_CONFIG                                                  \
   (EEPROM_ADDRESS_HEADER + EEPROM_HEADER_SIZE_BYTES)
-#define EEPROM_HEADUNIT_BRAND_SIZE_BYTES 1
 
-/* EEPROM data */
+/* Everything kept across power cycles, the RAM copy of the config record.
+ * New fields go on the end, see migrate_config(). config_record.py writes
+ * the same layout from the host */
+typedef struct __attribute__((packed)) {
+  uint8_t                         headunit_brand;
+  Generic_Pulse_Distance_Config_t generic_pulse_distance;
+  uint8_t                         hsi_trim_marker;
+  uint8_t                         hsi_trim;
+  MCP4131_Calibration_t           mcp4131_calibration;
+  uint8_t                         timing_profile_brand; // Profile tuned for
+  SWC_Timing_Profile_t            timing_profile;
+  uint8_t                         accepted_functions; // Learning wizard result
+} Config_t;
+
+static_assert(sizeof(Config_t) <= CONFIG_STORE_MAX_RECORD_SIZE,
+              "Config record doesn't fit in a config store page");
+/* The last field older firmware stored was at EEPROM address 0x2D */
+static_assert(EEPROM_ADDRESS_CONFIG + offsetof(Config_t, accepted_functions) ==
+                  0x2D,
+              "Config_t no longer matches the EEPROM layout it imports");
+
+/* EEPROM header of older firmware */
 const uint8_t eeprom_header[] = {0xDE, 0xAD, 0xBE, 0xEF};
 
+Config_t     config;
+Config_Store config_store;
+
+#ifdef SINGLE_HEADUNIT_BRAND
+/* Nothing else is built in, so there is nothing to choose at boot */
+Headunit_Brand_t headunit_brand = SINGLE_HEADUNIT_BRAND;
+#else
 Headunit_Brand_t headunit_brand = HEADUNIT_ALPINE;
+#endif
+
+/* Set while the learning wizard runs, so loop() can store the result */
+bool learning_active = false;
+
+bool status_led_on = false;
+
+Input_Event_Ring<INPUT_EVENT_RING_SIZE> input_event_ring;
+
+/* Single register accesses, used where the pin is fixed at compile time */
+typedef Fast_GPIO_Port<ENCODER_GPIO_PORT_BASE>                 Encoder_Port;
+typedef Fast_GPIO<STATUS_LED_GPIO_PORT_BASE, STATUS_LED_GPIO_BIT> Status_LED;
+
+#ifdef FAST_GPIO_BENCHMARK
+/* Nanoseconds per write, read these out with the debugger */
+uint32_t digital_write_ns   = 0;
+uint32_t fast_gpio_write_ns = 0;
+#endif
+
+MCP4131      mcp4131;
+Pulse_Engine pulse_engine;
+
+/* Every driver that can be selected at boot, one line per brand naming its
+ * driver class and its setup_*() below. headunit_storage, the factories and
+ * headunit_registry are all generated from this list. Brands needing the USB
+ * stack are left out entirely without it */
+#ifdef USB_HID_BUILT_IN
+#define HEADUNIT_USB_DRIVERS(DRIVER)                                           \
+  DRIVER(HEADUNIT_USB_HID, USB_HID_SWC, usb_hid_swc)                           \
+  DRIVER(SWC_TESTING, Testing, testing_swc)
+#else
+#define HEADUNIT_USB_DRIVERS(DRIVER)
+#endif
+
+#define HEADUNIT_DRIVERS(DRIVER)                                               \
+  DRIVER(HEADUNIT_GENERIC_RESISTIVE, Generic_Resistive_SWC,                    \
+         generic_resistive_swc)                                                \
+  DRIVER(HEADUNIT_JVC, JVC_SWC, jvc_swc)                                       \
+  DRIVER(HEADUNIT_KENWOOD, Kenwood_SWC, kenwood_swc)                           \
+  DRIVER(HEADUNIT_ALPINE, Alpine_SWC, alpine_swc)                              \
+  DRIVER(HEADUNIT_PIONEER, Pioneer_SWC, pioneer_swc)                           \
+  HEADUNIT_USB_DRIVERS(DRIVER)                                                 \
+  DRIVER(HEADUNIT_GENERIC_PULSE_DISTANCE, Generic_Pulse_Distance_SWC,          \
+         generic_pulse_distance_swc)
+
+#define HEADUNIT_STORAGE_ENTRY(brand, driver, name)                            \
+  Headunit_Driver<brand, driver>,
+
+Headunit_Storage<HEADUNIT_DRIVERS(HEADUNIT_STORAGE_ENTRY) Headunit_List_End>
+    headunit_storage;
+
+Headunit_SWC *headunit_swc = nullptr; // Driver for headunit_brand
+/* Only set when the generic resistive driver was selected, for the wizard */
+Generic_Resistive_SWC *generic_resistive_swc = nullptr;
+SWC_Command_Queue      swc_command_queue;
+
+Quadrature_Decoder quadrature_decoder;
+ISR_Profiler       encoder_isr_profiler;
+Encoder_Timer      encoder_timer;
+Volume_Accelerator volume_accelerator;
+Button_Gesture     button_gesture;
+Input_Filter       input_filter;
+HardwareTimer     *input_sample_timer;
+Power_Manager      power_manager;
+Timer_Capture      loopback_capture;
+Clock_Calibration  clock_calibration;
+Boot_Profiler      boot_profiler; // Read out with the debugger
+
+/* Generic resistive driver if it was selected. Always nullptr when it isn't
+ * built in, so the wizard code below folds away in other single-brand images */
+static inline Generic_Resistive_SWC *resistive_driver(void) {
+  return headunit_built_in(HEADUNIT_GENERIC_RESISTIVE) ? generic_resistive_swc
+                                                       : nullptr;
+}
 
-volatile int8_t  encoder_count = 0;
-volatile uint8_t encoder_flags = 0;
+/* True while the generic resistive learning wizard has the button */
+static inline bool is_learning(void) {
+  return resistive_driver() && resistive_driver()->is_learning();
+}
 
-MCP4131               mcp4131;
-Generic_Resistive_SWC generic_resistive_swc;
-Kenwood_SWC           kenwood_swc;
-JVC_SWC               jvc_swc;
-Alpine_SWC            alpine_swc;
-Pioneer_SWC           pioneer_swc;
-USB_HID_SWC           usb_hid_swc;
-Testing               testing;
+/* Current encoder port state, filtered when the sampled backend is used */
+static inline uint32_t read_encoder_port_state(void) {
+#if ENCODER_INPUT_BACKEND == ENCODER_INPUT_BACKEND_SAMPLED
+  return input_filter.get_filtered_state();
+#else
+  return Encoder_Port::read();
+#endif
+}
+
+/* Returns the encoder state as (A << 1) | B */
+static inline uint8_t encoder_ab_state(uint32_t port_state) {
+  return (((port_state >> ENCODER_A_GPIO_BIT) & 1) << 1) |
+         ((port_state >> ENCODER_B_GPIO_BIT) & 1);
+}
+
+/* The button is active low */
+static inline bool encoder_button_pressed(uint32_t port_state) {
+  return !(port_state & (1 << ENCODER_SW_GPIO_BIT));
+}
 
 void encoder_rotation_interrupt_handler(void) {
-  /* Disable global interrupts to avoid race conditions */
-  __disable_irq();
-  /* Encoder Pin A triggered the interrupt. Read Pin B to determine state change
-   */
-  if (digitalRead(PIN_INPUT_ENCODER_B)) {
-    /* We have a CCW rotation */
-    if (encoder_count > MIN_ENCODER_COUNT) {
-      encoder_count -= 1;
-    }
-    /* Enable global interrupts */
-    __enable_irq();
-    return;
+  uint32_t isr_start_ticks = ISR_Profiler::timestamp();
+  /* Either encoder pin changed. Both channels are decoded on every edge */
+  int8_t detent =
+      quadrature_decoder.update(encoder_ab_state(Encoder_Port::read()));
+  if (detent) {
+    input_event_ring.push(INPUT_EVENT_ROTATION, detent, millis());
   }
-  /* We have a CW rotation */
-  if (encoder_count < MAX_ENCODER_COUNT) {
-    encoder_count += 1;
-  }
-  /* Enable global interrupts */
-  __enable_irq();
+  encoder_isr_profiler.record(isr_start_ticks);
 }
 
 void encoder_button_interrupt_handler(void) {
-  /* First, disable interrupt to avoid triggering again */
-  detachInterrupt(PIN_INPUT_ENCODER_SW);
-  /* Disable global interrupts to avoid race conditions */
-  __disable_irq();
-  /* Now we tell the main loop that the button has been pressed and set the
-   * initial time */
-  encoder_flags |= ENCODER_FLAG_BUTTON_TIMER_STARTED_BM;
-  /* Finally, enable global interrupts */
-  __enable_irq();
-}
-
-void on_encoder_rotation(bool cw_rotation) {
-  switch (headunit_brand) {
-  case HEADUNIT_GENERIC_RESISTIVE:
-    generic_resistive_swc.on_encoder_rotation(cw_rotation);
-    break;
+  /* Fires on both edges, the gesture recogniser works out the rest */
+  input_event_ring.push(encoder_button_pressed(Encoder_Port::read())
+                            ? INPUT_EVENT_BUTTON_PRESSED
+                            : INPUT_EVENT_BUTTON_RELEASED,
+                        0, millis());
+}
 
-  case HEADUNIT_JVC:
-    jvc_swc.on_encoder_rotation(cw_rotation);
-    break;
+#if ENCODER_INPUT_BACKEND == ENCODER_INPUT_BACKEND_SAMPLED
+/* The update event runs the sample ISR straight away, so the edge that
+ * started sampling isn't held back by a timer period */
+static inline void start_input_sampling(void) {
+  INPUT_SAMPLE_TIMER->CTLR1 |= TIM_CEN;
+  INPUT_SAMPLE_TIMER->SWEVGR = TIM_UG;
+}
 
-  case HEADUNIT_KENWOOD:
-    kenwood_swc.on_encoder_rotation(cw_rotation);
-    break;
+/* Any edge on the encoder pins, the sample ISR does the rest. Edges while it
+ * is running are picked up by its next sample */
+void input_edge_interrupt_handler(void) {
+  if (!(INPUT_SAMPLE_TIMER->CTLR1 & TIM_CEN)) {
+    start_input_sampling();
+  }
+}
 
-  case HEADUNIT_ALPINE:
-    alpine_swc.on_encoder_rotation(cw_rotation);
+void input_sample_interrupt_handler(void) {
+  uint32_t isr_start_ticks = ISR_Profiler::timestamp();
+  uint32_t changed         = input_filter.sample(Encoder_Port::read());
+  if (changed) {
+    uint32_t filtered_state = input_filter.get_filtered_state();
+    if (changed & ((1 << ENCODER_A_GPIO_BIT) | (1 << ENCODER_B_GPIO_BIT))) {
+      int8_t detent =
+          quadrature_decoder.update(encoder_ab_state(filtered_state));
+      if (detent) {
+        input_event_ring.push(INPUT_EVENT_ROTATION, detent, millis());
+      }
+    }
+    if (changed & (1 << ENCODER_SW_GPIO_BIT)) {
+      input_event_ring.push(encoder_button_pressed(filtered_state)
+                                ? INPUT_EVENT_BUTTON_PRESSED
+                                : INPUT_EVENT_BUTTON_RELEASED,
+                            0, millis());
+    }
+  }
+  /* Nothing left to time, wait for the next edge without waking WFI */
+  if (input_filter.is_settled(Encoder_Port::read())) {
+    INPUT_SAMPLE_TIMER->CTLR1 &= ~TIM_CEN;
+    /* An edge between the read and the stop saw the timer still running */
+    if (!input_filter.is_settled(Encoder_Port::read())) {
+      start_input_sampling();
+    }
+  }
+  encoder_isr_profiler.record(isr_start_ticks);
+}
+#endif
+
+void register_button_gesture(Button_Gesture_t gesture) {
+  switch (gesture) {
+  case BUTTON_GESTURE_SINGLE_PRESS:
+    if (is_learning()) {
+      generic_resistive_swc->on_learning_press();
+    } else {
+      swc_command_queue.enqueue(SWC_COMMAND_SHORT_PRESS);
+    }
     break;
 
-  case HEADUNIT_PIONEER:
-    pioneer_swc.on_encoder_rotation(cw_rotation);
+  case BUTTON_GESTURE_DOUBLE_PRESS:
+    if (is_learning()) {
+      generic_resistive_swc->on_learning_double_press();
+    } else if (resistive_driver()) {
+      /* Starts the learning wizard, anything not sent yet is dropped */
+      swc_command_queue.clear();
+      generic_resistive_swc->start_learning();
+    } else {
+      swc_command_queue.enqueue(SWC_COMMAND_DOUBLE_PRESS);
+    }
     break;
 
-  case HEADUNIT_USB_HID:
-    usb_hid_swc.on_encoder_rotation(cw_rotation);
+  case BUTTON_GESTURE_HELD:
+    if (is_learning()) {
+      generic_resistive_swc->on_learning_held();
+    } else {
+      swc_command_queue.enqueue(SWC_COMMAND_HELD);
+    }
     break;
 
   default:
@@ -144,153 +415,430 @@ void on_encoder_rotation(bool cw_rotation) {
   }
 }
 
-void on_encoder_button_short_press(void) {
-  switch (headunit_brand) {
-  case HEADUNIT_GENERIC_RESISTIVE:
-    generic_resistive_swc.on_button_short_press();
-    break;
+/* Queues one command per step. The queue nets steps against the ones that
+ * haven't been sent yet, so a quick spin back cancels them */
+void queue_rotation(int16_t steps, SWC_Command_t cw_command,
+                    SWC_Command_t ccw_command) {
+  SWC_Command_t command   = (steps > 0) ? cw_command : ccw_command;
+  uint16_t      remaining = (steps > 0) ? steps : -steps;
+  while (remaining) {
+    uint8_t count = min(remaining, (uint16_t)UINT8_MAX);
+    swc_command_queue.enqueue(command, count);
+    remaining -= count;
+  }
+}
 
-  case HEADUNIT_JVC:
-    jvc_swc.on_button_short_press();
-    break;
+/* Trims accelerated steps back towards 1:1 once the output falls behind, so
+ * the volume doesn't keep moving long after the knob has stopped */
+int16_t limit_acceleration(int16_t detents, int16_t steps) {
+  uint16_t backlog  = swc_command_queue.get_backlog();
+  uint16_t minimum  = abs(detents);
+  uint16_t room     = (backlog < VOLUME_ACCELERATION_MAX_BACKLOG)
+                          ? VOLUME_ACCELERATION_MAX_BACKLOG - backlog
+                          : 0;
+  uint16_t accepted = max(minimum, min((uint16_t)abs(steps), room));
+  return (steps > 0) ? accepted : -accepted;
+}
 
-  case HEADUNIT_KENWOOD:
-    kenwood_swc.on_button_short_press();
-    break;
+void register_rotation(int16_t detents, uint32_t timestamp_ms) {
+  if (detents == 0 || is_learning()) {
+    return;
+  }
+  if (button_gesture.on_rotation()) {
+    /* Push-and-turn, every detent is a track skip with no acceleration */
+    queue_rotation(detents, SWC_COMMAND_ROTATION_WHILE_PRESSED_CW,
+                   SWC_COMMAND_ROTATION_WHILE_PRESSED_CCW);
+    return;
+  }
+  int16_t steps = limit_acceleration(
+      detents, volume_accelerator.on_rotation(detents, timestamp_ms));
+  queue_rotation(steps, SWC_COMMAND_ROTATION_CW, SWC_COMMAND_ROTATION_CCW);
+}
 
-  case HEADUNIT_ALPINE:
-    alpine_swc.on_button_short_press();
-    break;
+/* Power_Manager's last look before STOP, with interrupts masked. Nothing may
+ * be waiting in the ring, and on the sampled backend no lock-out window may be
+ * running or edge be waiting for its next sample */
+bool inputs_idle(void) {
+  if (!input_event_ring.is_empty()) {
+    return false;
+  }
+#if ENCODER_INPUT_BACKEND == ENCODER_INPUT_BACKEND_SAMPLED
+  return input_filter.is_settled(Encoder_Port::read());
+#else
+  return true;
+#endif
+}
 
-  case HEADUNIT_PIONEER:
-    pioneer_swc.on_button_short_press();
-    break;
+/* Moves everything the ISRs have queued into the loop() owned input state */
+void collect_input_events(void) {
+#if ENCODER_INPUT_BACKEND == ENCODER_INPUT_BACKEND_TIMER
+  /* Rotation is counted in hardware, pick up everything since last time */
+  register_rotation(encoder_timer.read_delta(), millis());
+#endif
+  Input_Event_t input_event;
+  while (input_event_ring.pop(&input_event)) {
+    boot_profiler.mark(BOOT_PHASE_FIRST_INPUT);
+    switch (input_event.type) {
+    case INPUT_EVENT_ROTATION:
+      register_rotation(input_event.value, input_event.timestamp_ms);
+      break;
+
+    case INPUT_EVENT_BUTTON_PRESSED:
+    case INPUT_EVENT_BUTTON_RELEASED:
+      register_button_gesture(button_gesture.on_button_edge(
+          input_event.type == INPUT_EVENT_BUTTON_PRESSED,
+          input_event.timestamp_ms));
+      break;
+
+    default:
+      break;
+    }
+  }
+}
 
-  case HEADUNIT_USB_HID:
-    usb_hid_swc.on_button_short_press();
-    break;
+/* Where the learning wizard is, worked out from the time in its state */
+bool learning_led_pattern(uint32_t now_ms) {
+  Generic_Resistive_SWC *driver = resistive_driver();
+  if (!driver) {
+    return false;
+  }
+  uint32_t elapsed = now_ms - driver->get_learning_timestamp();
+  switch (driver->get_learning_state()) {
+  case LEARNING_PROMPT: {
+    uint32_t blinks_ms =
+        (driver->get_learning_step() + 1) * 2 * STATUS_LED_PROMPT_BLINK_MS;
+    uint32_t phase = elapsed % (blinks_ms + STATUS_LED_PROMPT_PAUSE_MS);
+    return phase < blinks_ms && (phase / STATUS_LED_PROMPT_BLINK_MS) % 2 == 0;
+  }
 
-  case SWC_TESTING:
-    testing.on_button_short_press();
-    break;
+  case LEARNING_HOLDING:
+    return true;
+
+  case LEARNING_CONFIRM:
+    return (elapsed / STATUS_LED_LEARNING_FLASH_MS) % 2 == 0;
 
   default:
-    break;
+    return false;
   }
 }
 
-void on_encoder_button_held(void) {
-  switch (headunit_brand) {
-  case HEADUNIT_GENERIC_RESISTIVE:
-    generic_resistive_swc.on_button_held();
-    break;
+/* Lit while commands are going out, patterned while learning */
+void update_status_led(uint32_t now_ms) {
+  bool led_on = !swc_command_queue.is_idle();
+  if (is_learning()) {
+    led_on = learning_led_pattern(now_ms);
+  }
+  if (led_on != status_led_on) {
+    status_led_on = led_on;
+    Status_LED::write(led_on);
+  }
+}
 
-  case HEADUNIT_JVC:
-    jvc_swc.on_button_held();
-    break;
+#ifdef FAST_GPIO_BENCHMARK
+/* Times the same LED writes both ways against SysTick */
+void run_fast_gpio_benchmark(void) {
+  ISR_Profiler digital_write_profiler;
+  ISR_Profiler fast_gpio_profiler;
 
-  case HEADUNIT_KENWOOD:
-    kenwood_swc.on_button_held();
-    break;
+  uint32_t start_ticks = ISR_Profiler::timestamp();
+  for (uint8_t i = 0; i < FAST_GPIO_BENCHMARK_WRITES; i++) {
+    digitalWrite(STATUS_LED_PIN, i & 1);
+  }
+  digital_write_profiler.record(start_ticks);
 
-  case HEADUNIT_ALPINE:
-    alpine_swc.on_button_held();
-    break;
+  start_ticks = ISR_Profiler::timestamp();
+  for (uint8_t i = 0; i < FAST_GPIO_BENCHMARK_WRITES; i++) {
+    Status_LED::write(i & 1);
+  }
+  fast_gpio_profiler.record(start_ticks);
 
-  case HEADUNIT_PIONEER:
-    pioneer_swc.on_button_held();
-    break;
+  digital_write_ns =
+      digital_write_profiler.get_worst_case_ns() / FAST_GPIO_BENCHMARK_WRITES;
+  fast_gpio_write_ns =
+      fast_gpio_profiler.get_worst_case_ns() / FAST_GPIO_BENCHMARK_WRITES;
+  Status_LED::clear();
+}
+#endif
 
-  case HEADUNIT_USB_HID:
-    usb_hid_swc.on_button_held();
-    break;
+#if ENCODER_INPUT_BACKEND != ENCODER_INPUT_BACKEND_TIMER
+/* Applies the stored HSI trim, then re-trims it if a reference is on PA0 */
+void calibrate_clock(void) {
+  if (config.hsi_trim_marker == HSI_TRIM_MARKER) {
+    Clock_Calibration::set_hsi_trim(config.hsi_trim);
+  }
 
-  default:
-    break;
+  loopback_capture.init_timer_capture(CAPTURE_TIMER, CAPTURE_TICK_HZ);
+  clock_calibration.init_clock_calibration(&loopback_capture, CAPTURE_TICK_HZ,
+                                           CLOCK_REFERENCE_HZ);
+  /* Nothing on PA0 on a normal boot, don't wait out a whole measurement */
+  if (clock_calibration.is_reference_present(CLOCK_REFERENCE_DETECT_MS) &&
+      clock_calibration.calibrate(CLOCK_CALIBRATION_TIMEOUT_MS)) {
+    config.hsi_trim_marker = HSI_TRIM_MARKER;
+    config.hsi_trim        = Clock_Calibration::get_hsi_trim();
+    config_store.mark_dirty(millis());
   }
 }
+#endif
+
+/* Each setup does what only its brand needs once the driver has been built
+ * into headunit_storage. The MCP4131 is already initialised */
+static void setup_generic_resistive_swc(Generic_Resistive_SWC *driver) {
+  generic_resistive_swc = driver;
+  generic_resistive_swc->init_generic_resistive_swc(&mcp4131,
+                                                    PIN_OUTPUT_SWC_GND_EN);
+  /* Only the functions the headunit took last time are sent, an erased byte
+   * reads back with every function set */
+  generic_resistive_swc->set_accepted_functions(
+      config.accepted_functions & RESISTIVE_ALL_FUNCTIONS);
+}
 
-void on_encoder_button_double_pressed(void) {
-  switch (headunit_brand) {
-  case HEADUNIT_GENERIC_RESISTIVE:
-    generic_resistive_swc.on_button_double_press();
-    break;
-
-  case HEADUNIT_JVC:
-    jvc_swc.on_button_double_press();
-    break;
+static void setup_jvc_swc(JVC_SWC *jvc_swc) {
+  pulse_engine.init_pulse_engine(PULSE_ENGINE_TIMER);
+  jvc_swc->init_jvc_swc(PIN_OUTPUT_SWC_GND_EN, &pulse_engine);
+}
 
-  case HEADUNIT_KENWOOD:
-    kenwood_swc.on_button_double_press();
-    break;
+static void setup_kenwood_swc(Kenwood_SWC *kenwood_swc) {
+  pulse_engine.init_pulse_engine(PULSE_ENGINE_TIMER);
+  kenwood_swc->init_kenwood_swc(PIN_OUTPUT_SWC_GND_EN, &pulse_engine);
+}
 
-  case HEADUNIT_ALPINE:
-    alpine_swc.on_button_double_press();
-    break;
+static void setup_alpine_swc(Alpine_SWC *alpine_swc) {
+  /* The only brand driving the push-pull output */
+  pinMode(PIN_OUPUT_SWC_PUSH_PULL, OUTPUT);
+  digitalWrite(PIN_OUPUT_SWC_PUSH_PULL, LOW);
+  mcp4131.disconnect_wiper(); // Ensure disconnected
+  pulse_engine.init_pulse_engine(PULSE_ENGINE_TIMER);
+  alpine_swc->init_alpine_swc(PIN_OUPUT_SWC_PUSH_PULL, &pulse_engine);
+}
 
-  case HEADUNIT_PIONEER:
-    pioneer_swc.on_button_double_press();
-    break;
+static void setup_pioneer_swc(Pioneer_SWC *pioneer_swc) {
+  pioneer_swc->init_pioneer_swc(&mcp4131, PIN_OUTPUT_SWC_GND_EN);
+}
 
-  case HEADUNIT_USB_HID:
-    usb_hid_swc.on_button_double_press();
-    break;
+#ifdef USB_HID_BUILT_IN
+static void setup_usb_hid_swc(USB_HID_SWC *usb_hid_swc) {
+  usb_hid_swc->init_usb_hid_swc();
+}
 
-  default:
-    break;
+/* The harness drives the USB output too */
+static void setup_testing_swc(Testing *testing) {
+  pulse_engine.init_pulse_engine(PULSE_ENGINE_TIMER);
+  testing->init_testing(&mcp4131, SPI_CHIP_SEL_PIN, PIN_OUTPUT_SWC_GND_EN,
+                        PIN_OUPUT_SWC_PUSH_PULL, &pulse_engine,
+#if ENCODER_INPUT_BACKEND != ENCODER_INPUT_BACKEND_TIMER
+                        &loopback_capture);
+#else
+                        nullptr);
+#endif
+}
+#endif
+
+static void
+setup_generic_pulse_distance_swc(Generic_Pulse_Distance_SWC *driver) {
+  /* Timings and command codes come from the config record */
+  Generic_Pulse_Distance_Config_t protocol_config =
+      config.generic_pulse_distance;
+  if (!Generic_Pulse_Distance_SWC::is_config_valid(&protocol_config)) {
+    /* Never written, e.g. imported from an EEPROM formatted by firmware
+     * older than this brand */
+    protocol_config = generic_pulse_distance_default_config;
   }
+  pulse_engine.init_pulse_engine(PULSE_ENGINE_TIMER);
+  driver->init_generic_pulse_distance_swc(PIN_OUTPUT_SWC_GND_EN, &pulse_engine,
+                                          &protocol_config);
 }
 
-void setup() {
-  /* Load EEPROM */
-  EEPROM.begin();
-  uint8_t index_counter = 0; // Temp variable for for-loops
-
-  /* Check the EEPROM header on boot to check if it has been formatted */
-  uint8_t current_eeprom_header[EEPROM_HEADER_SIZE_BYTES];
-  for (index_counter = EEPROM_ADDRESS_HEADER;
-       index_counter < EEPROM_HEADER_SIZE_BYTES; index_counter++) {
-    current_eeprom_header[index_counter] = EEPROM.read(index_counter);
+/* Builds the brand's driver into headunit_storage, then runs its setup. A
+ * brand left out of a single-brand build never references its setup or
+ * driver */
+#define HEADUNIT_FACTORY(brand, driver, name)                                  \
+  static Headunit_SWC *create_##name(void) {                                   \
+    if constexpr (headunit_built_in(brand)) {                                  \
+      driver *swc = headunit_storage.emplace<brand, driver>();                 \
+      setup_##name(swc);                                                       \
+      return swc;                                                              \
+    }                                                                          \
+    return nullptr;                                                            \
   }
 
-  if (memcmp(eeprom_header, current_eeprom_header, EEPROM_HEADER_SIZE_BYTES) !=
-      0) // Header not formatted
-  {
-    /* EEPROM is not set, we must set it up now */
-    EEPROM.write(EEPROM_ADDRESS_HEADUNIT_BRAND,
-                 (uint8_t)HEADUNIT_GENERIC_RESISTIVE);
-    /* Finally, set the EEPROM header */
-    for (index_counter = EEPROM_ADDRESS_HEADER;
-         index_counter < EEPROM_HEADER_SIZE_BYTES; index_counter++) {
-      EEPROM.write(index_counter, eeprom_header[index_counter]);
+HEADUNIT_DRIVERS(HEADUNIT_FACTORY)
+
+/* Brands left out of a single-brand build have no factory. The factories are
+ * static, so one that isn't referenced isn't emitted */
+#define HEADUNIT_REGISTRY_ENTRY(brand, driver, name)                           \
+  {brand, headunit_built_in(brand) ? create_##name : nullptr},
+
+const Headunit_Registry_Entry_t headunit_registry[] = {
+    HEADUNIT_DRIVERS(HEADUNIT_REGISTRY_ENTRY)};
+
+/* Looked up once at boot, every event after that is one virtual call */
+Headunit_SWC *create_headunit_swc(Headunit_Brand_t brand) {
+  for (const Headunit_Registry_Entry_t &entry : headunit_registry) {
+    if (entry.brand == brand && entry.create) {
+      return entry.create();
     }
+  }
+  return nullptr;
+}
+
+/* What a blank unit starts with */
+void set_config_defaults(void) {
+  config.headunit_brand         = HEADUNIT_GENERIC_RESISTIVE;
+  config.generic_pulse_distance = generic_pulse_distance_default_config;
+  config.hsi_trim_marker        = 0;
+  config.hsi_trim               = HSI_TRIM_DEFAULT;
+  config.mcp4131_calibration    = mcp4131_nominal_calibration;
+  /* No tuned timing profile, every brand starts on its defaults */
+  config.timing_profile_brand = HEADUNIT_BRAND_ERROR;
+  config.timing_profile       = {};
+  config.accepted_functions   = RESISTIVE_ALL_FUNCTIONS;
+}
 
-    /* We can commit it to the flash storage */
-    EEPROM.commit(); // Call commit to ensure EEPROM is written to flash
+/* load() copied a record of another version over the defaults as far as it
+ * went. Fields are only ever appended to Config_t, so everything the record
+ * had is already in place and anything newer is on its default. A field that
+ * changes its layout bumps CONFIG_VERSION and is converted or reset here for
+ * the versions before the change, e.g.
+ *   if (from_version < 2) { config.timing_profile = {}; }
+ * A record from newer firmware keeps the fields this one knows about */
+void migrate_config(uint8_t from_version) {
+  (void)from_version; // No field has changed its layout since version 1
+}
+
+/* Fills the RAM copy of the config record. A unit coming from older firmware
+ * has its EEPROM settings imported, a blank one starts on the defaults. Every
+ * field is checked where it is used, imported ones may be stale */
+void load_config(void) {
+  config_store.init_config_store(CONFIG_STORE_FLASH_ADDRESS,
+                                 CONFIG_STORE_PAGES, &config, sizeof(Config_t),
+                                 CONFIG_VERSION, CONFIG_COMMIT_DELAY_MS);
+  set_config_defaults();
+  if (config_store.load()) {
+    if (config_store.get_loaded_version() != CONFIG_VERSION) {
+      migrate_config(config_store.get_loaded_version());
+      config_store.commit(); // Rewritten in this version's layout
+    }
+    return;
   }
 
-  else {
-    headunit_brand =
-        (Headunit_Brand_t)EEPROM.read(EEPROM_ADDRESS_HEADUNIT_BRAND);
+  EEPROM.begin();
+  uint8_t current_eeprom_header[EEPROM_HEADER_SIZE_BYTES];
+  for (uint8_t index_counter = 0; index_counter < EEPROM_HEADER_SIZE_BYTES;
+       index_counter++) {
+    current_eeprom_header[index_counter] =
+        EEPROM.read(EEPROM_ADDRESS_HEADER + index_counter);
+  }
+  if (memcmp(eeprom_header, current_eeprom_header, EEPROM_HEADER_SIZE_BYTES) ==
+      0) {
+    uint8_t *config_bytes = (uint8_t *)&config;
+    for (uint8_t index_counter = 0; index_counter < sizeof(Config_t);
+         index_counter++) {
+      config_bytes[index_counter] =
+          EEPROM.read(EEPROM_ADDRESS_CONFIG + index_counter);
+    }
   }
+  config_store.commit();
+}
 
+/* Starts taking encoder input. Events queue up in input_event_ring until
+ * loop() runs, so nothing is lost while the rest of setup() finishes */
+void arm_inputs(void) {
   pinMode(PIN_INPUT_ENCODER_A, INPUT_PULLUP);
   pinMode(PIN_INPUT_ENCODER_B, INPUT_PULLUP);
   pinMode(PIN_INPUT_ENCODER_SW, INPUT_PULLUP);
 
+  volume_accelerator.init_volume_accelerator(
+      volume_acceleration_curve,
+      sizeof(volume_acceleration_curve) / sizeof(volume_acceleration_curve[0]));
+
+  button_gesture.init_button_gesture(BUTTON_HELD_TIME_THRESHOLD_MS,
+                                     BUTTON_RELEASED_TIME_THRESHOLD_MS,
+                                     BUTTON_DEBOUNCE_TIME_MS);
+
+#if ENCODER_INPUT_BACKEND == ENCODER_INPUT_BACKEND_SAMPLED
+  /* One timer ISR samples all three inputs, only while they are moving */
+  input_filter.init_input_filter(ENCODER_GPIO_PORT->INDR, ENCODER_GPIO_MASK,
+                                 INPUT_LOCKOUT_SAMPLES);
+  quadrature_decoder.init_quadrature_decoder(
+      encoder_ab_state(input_filter.get_filtered_state()), ENCODER_RESOLUTION);
+  input_sample_timer = new HardwareTimer(INPUT_SAMPLE_TIMER);
+  input_sample_timer->setOverflow(INPUT_SAMPLE_RATE_HZ, HERTZ_FORMAT);
+  input_sample_timer->attachInterrupt(input_sample_interrupt_handler);
+  /* Latch the period now, then leave the timer stopped until an edge */
+  input_sample_timer->resume();
+  INPUT_SAMPLE_TIMER->CTLR1 &= ~TIM_CEN;
+  INPUT_SAMPLE_TIMER->INTFR = (uint16_t)~TIM_UIF;
+  attachInterrupt(PIN_INPUT_ENCODER_A, GPIO_Mode_IPU,
+                  input_edge_interrupt_handler, EXTI_Mode_Interrupt,
+                  EXTI_Trigger_Rising_Falling);
+  attachInterrupt(PIN_INPUT_ENCODER_B, GPIO_Mode_IPU,
+                  input_edge_interrupt_handler, EXTI_Mode_Interrupt,
+                  EXTI_Trigger_Rising_Falling);
+  attachInterrupt(PIN_INPUT_ENCODER_SW, GPIO_Mode_IPU,
+                  input_edge_interrupt_handler, EXTI_Mode_Interrupt,
+                  EXTI_Trigger_Rising_Falling);
+#else
+#if ENCODER_INPUT_BACKEND == ENCODER_INPUT_BACKEND_TIMER
+  encoder_timer.init_encoder_timer(ENCODER_TIMER, ENCODER_RESOLUTION,
+                                   ENCODER_TIMER_INPUT_FILTER,
+                                   ENCODER_TIMER_REVERSE_DIRECTION);
+#else
+  quadrature_decoder.init_quadrature_decoder(
+      encoder_ab_state(ENCODER_GPIO_PORT->INDR), ENCODER_RESOLUTION);
+  attachInterrupt(PIN_INPUT_ENCODER_A, GPIO_Mode_IPU,
+                  encoder_rotation_interrupt_handler, EXTI_Mode_Interrupt,
+                  EXTI_Trigger_Rising_Falling);
+  attachInterrupt(PIN_INPUT_ENCODER_B, GPIO_Mode_IPU,
+                  encoder_rotation_interrupt_handler, EXTI_Mode_Interrupt,
+                  EXTI_Trigger_Rising_Falling);
+#endif
+  attachInterrupt(PIN_INPUT_ENCODER_SW, GPIO_Mode_IPU,
+                  encoder_button_interrupt_handler, EXTI_Mode_Interrupt,
+                  EXTI_Trigger_Rising_Falling);
+#endif
+}
+
+/* Inputs are armed first, then the outputs and the driver come up. The
+ * phases are timed in boot_profiler */
+void setup() {
+  boot_profiler.mark(BOOT_PHASE_SETUP_START);
+  load_config();
+#ifndef SINGLE_HEADUNIT_BRAND
+  headunit_brand = (Headunit_Brand_t)config.headunit_brand;
+#endif
+  boot_profiler.mark(BOOT_PHASE_CONFIG_LOADED);
+
+  arm_inputs();
+  boot_profiler.mark(BOOT_PHASE_INPUTS_ARMED);
+
+  /* Outputs to a safe state, the Alpine pin is high-impedance when not in
+   * use */
   pinMode(PIN_OUTPUT_SWC_GND_EN, OUTPUT);
   digitalWrite(PIN_OUTPUT_SWC_GND_EN, LOW);
+  pinMode(PIN_OUPUT_SWC_PUSH_PULL, INPUT);
 
   pinMode(STATUS_LED_PIN, OUTPUT);
   digitalWrite(STATUS_LED_PIN, LOW);
+#ifdef FAST_GPIO_BENCHMARK
+  run_fast_gpio_benchmark();
+#endif
 
   /* All unused pins tied to either VCC or GND */
+#if ENCODER_INPUT_BACKEND != ENCODER_INPUT_BACKEND_TIMER
   pinMode(PA0, INPUT_PULLDOWN);
+#else
+  pinMode(PA2, INPUT_PULLDOWN);
+#endif
   pinMode(PB12, INPUT_PULLDOWN);
   pinMode(PC14, INPUT_PULLDOWN);
   pinMode(PB0, INPUT_PULLDOWN);
   pinMode(PB1, INPUT_PULLDOWN);
+#if ENCODER_INPUT_BACKEND != ENCODER_INPUT_BACKEND_TIMER
+  calibrate_clock();
+#endif
+  boot_profiler.mark(BOOT_PHASE_CLOCK_CALIBRATED);
 
+#ifndef SINGLE_HEADUNIT_BRAND
   /* Let's see if someone wants to change the headunit brand. This is done by
    * holding the button down on boot */
   if (!digitalRead(PIN_INPUT_ENCODER_SW)) {
@@ -329,8 +877,8 @@ void setup() {
               headunit_index = (uint8_t)HEADUNIT_GENERIC_RESISTIVE;
             }
             /* Button held, let's save the headunit brand and break out */
-            EEPROM.write(EEPROM_ADDRESS_HEADUNIT_BRAND, headunit_index);
-            EEPROM.commit();
+            config.headunit_brand = headunit_index;
+            config_store.commit();
             headunit_brand = (Headunit_Brand_t)headunit_index;
             user_completed = true;
             while (!digitalRead(PIN_INPUT_ENCODER_SW)) {
@@ -342,7 +890,8 @@ void setup() {
             /* Wait and then flash x times to show the current headunit selected
              */
             delay(1000);
-            for (index_counter = 0; index_counter < (uint8_t)headunit_brand;
+            for (uint8_t index_counter = 0;
+                 index_counter < (uint8_t)headunit_brand;
                  index_counter++) {
               digitalWrite(STATUS_LED_PIN, HIGH);
               delay(250);
@@ -364,161 +913,82 @@ void setup() {
         delay(10);
       }
     }
+    /* The button was only ever meant for the brand selection */
+    input_event_ring.discard();
+#if ENCODER_INPUT_BACKEND == ENCODER_INPUT_BACKEND_TIMER
+    encoder_timer.read_delta();
+#endif
   }
-
-  if (headunit_brand == HEADUNIT_ALPINE) {
-    pinMode(PIN_OUPUT_SWC_PUSH_PULL, OUTPUT);
-    digitalWrite(PIN_OUPUT_SWC_PUSH_PULL, LOW);
-  }
-
-  else {
-    /* Alpine pin needs to be high-impedance when not in use */
-    pinMode(PIN_OUPUT_SWC_PUSH_PULL, INPUT);
-  }
-
-  mcp4131.init(&SPI, SPI_CHIP_SEL_PIN);
-  mcp4131.set_output_resistance(0); // Connect wiper to B-terminal
-
-  switch (headunit_brand) {
-  case HEADUNIT_GENERIC_RESISTIVE:
-    generic_resistive_swc.init_generic_resistive_swc(&mcp4131,
-                                                     PIN_OUTPUT_SWC_GND_EN);
-    break;
-
-  case HEADUNIT_JVC:
-    jvc_swc.init_jvc_swc(PIN_OUTPUT_SWC_GND_EN);
-    break;
-
-  case HEADUNIT_KENWOOD:
-    kenwood_swc.init_kenwood_swc(PIN_OUTPUT_SWC_GND_EN);
-    break;
-
-  case HEADUNIT_ALPINE:
-    mcp4131.disconnect_wiper(); // Ensure disconnected
-    alpine_swc.init_alpine_swc(PIN_OUPUT_SWC_PUSH_PULL);
-    break;
-
-  case HEADUNIT_PIONEER:
-    pioneer_swc.init_pioneer_swc(&mcp4131, PIN_OUTPUT_SWC_GND_EN);
-    break;
-
-  case HEADUNIT_USB_HID:
-    usb_hid_swc.init_usb_hid_swc();
-    break;
-
-  case SWC_TESTING:
-    testing.init_testing(&mcp4131, SPI_CHIP_SEL_PIN, PIN_OUTPUT_SWC_GND_EN,
-                         PIN_OUPUT_SWC_PUSH_PULL, &alpine_swc,
-                         &generic_resistive_swc, &jvc_swc, &kenwood_swc,
-                         &pioneer_swc, &usb_hid_swc);
-    break;
-
-  default:
-    break;
+#endif
+  boot_profiler.mark(BOOT_PHASE_BRAND_SELECTED);
+
+  /* Measured R_AB and wiper resistance of this unit's pot, the resistive
+   * brands build their wiper tables from it. Nominal if not plausible */
+  mcp4131.set_calibration(config.mcp4131_calibration);
+  mcp4131.init(&SPI, SPI_CHIP_SEL_PIN, 0x00); // Wiper to B-terminal
+  boot_profiler.mark(BOOT_PHASE_POT_READY);
+
+  headunit_swc = create_headunit_swc(headunit_brand);
+
+  /* A profile tuned for this brand replaces the driver's default timings */
+  if (headunit_swc && config.timing_profile_brand == (uint8_t)headunit_brand) {
+    SWC_Timing_Profile_t timing_profile = config.timing_profile;
+    if (Headunit_SWC::is_timing_profile_valid(&timing_profile)) {
+      headunit_swc->set_timing_profile(&timing_profile);
+    }
   }
-
-  attachInterrupt(PIN_INPUT_ENCODER_A, GPIO_Mode_IPU,
-                  encoder_rotation_interrupt_handler, EXTI_Mode_Interrupt,
-                  EXTI_Trigger_Falling);
-  attachInterrupt(PIN_INPUT_ENCODER_SW, GPIO_Mode_IPU,
-                  encoder_button_interrupt_handler, EXTI_Mode_Interrupt,
-                  EXTI_Trigger_Falling);
+  swc_command_queue.init_swc_command_queue(headunit_swc);
+  boot_profiler.mark(BOOT_PHASE_DRIVER_READY);
+
+  /* Any of the encoder pins wakes us from STOP */
+  power_manager.init_power_manager(ENCODER_GPIO_PORT, ENCODER_GPIO_MASK,
+                                   POWER_STOP_IDLE_TIMEOUT_MS, inputs_idle);
+  power_manager.gate_unused_peripherals(
+      headunit_brand == HEADUNIT_GENERIC_RESISTIVE ||
+          headunit_brand == HEADUNIT_PIONEER || headunit_brand == SWC_TESTING,
+      headunit_brand == HEADUNIT_USB_HID || headunit_brand == SWC_TESTING);
+  boot_profiler.mark(BOOT_PHASE_SETUP_DONE);
 }
 
 void loop() {
-  /* Check if we have any input events */
-  while (encoder_count || encoder_flags) {
-    if (encoder_count != 0) {
-      digitalWrite(STATUS_LED_PIN, HIGH);
-      if (encoder_count > 0) {
-        /* CW rotation */
-        on_encoder_rotation(true);
-        encoder_count--;
-      }
-
-      else {
-        /* CCW rotation */
-        on_encoder_rotation(false);
-        encoder_count++;
-      }
-      digitalWrite(STATUS_LED_PIN, LOW);
-    }
-
-    if (encoder_flags & ENCODER_FLAG_BUTTON_TIMER_STARTED_BM) {
-      uint32_t delta_time_millis = 0;
-      while (delta_time_millis < BUTTON_HELD_TIME_THRESHOLD_MS &&
-             !digitalRead(PIN_INPUT_ENCODER_SW)) {
-        delay(10);
-        delta_time_millis += 10;
-      }
-      if (delta_time_millis >= 500) {
-        // If we reached here, the button was held
-        encoder_flags |= ENCODER_FLAG_ENCODER_BUTTON_HELD_BM;
-      }
-
-      else {
-        // Button has been released - we now wait to see if it gets pressed
-        // again
-        delta_time_millis = 0;
-        while (delta_time_millis < BUTTON_RELEASED_TIME_THRESHOLD_MS &&
-               digitalRead(PIN_INPUT_ENCODER_SW)) {
-          delay(10);
-          delta_time_millis += 10;
-        }
-        if (delta_time_millis >= BUTTON_RELEASED_TIME_THRESHOLD_MS) {
-          // Button was not pressed again, register single click
-          encoder_flags |= ENCODER_FLAG_ENCODER_BUTTON_SINGLE_PRESS_BM;
-        } else {
-          // Button pressed again, register double press
-          encoder_flags |= ENCODER_FLAG_ENCODER_BUTTON_DOUBLE_PRESS_BM;
-        }
-      }
-
-      // Finally, we can clear the flag
-      encoder_flags &= ~(ENCODER_FLAG_BUTTON_TIMER_STARTED_BM);
-      // and re-attach the ISR
-      attachInterrupt(PIN_INPUT_ENCODER_SW, GPIO_Mode_IPU,
-                      encoder_button_interrupt_handler, EXTI_Mode_Interrupt,
-                      EXTI_Trigger_Falling);
-    }
-
-    if (encoder_flags & ENCODER_FLAG_ENCODER_BUTTON_SINGLE_PRESS_BM) {
-      encoder_flags &=
-          ~(ENCODER_FLAG_ENCODER_BUTTON_SINGLE_PRESS_BM); // Clear the flag
-      digitalWrite(STATUS_LED_PIN, HIGH);
-      on_encoder_button_short_press();
-      digitalWrite(STATUS_LED_PIN, LOW);
-    }
-
-    if (encoder_flags & ENCODER_FLAG_ENCODER_BUTTON_HELD_BM) {
-      encoder_flags &= ~(ENCODER_FLAG_ENCODER_BUTTON_HELD_BM); // Clear the flag
-      digitalWrite(STATUS_LED_PIN, HIGH);
-      on_encoder_button_held();
-      digitalWrite(STATUS_LED_PIN, LOW);
+  /* Check if we have any input events. Nothing in here waits on the button
+   * or on a command going out, so input keeps flowing while they do */
+  collect_input_events();
+  register_button_gesture(button_gesture.tick(
+      millis(), encoder_button_pressed(read_encoder_port_state())));
+
+  /* Hands the next command over once the headunit can take it */
+  swc_command_queue.service();
+
+  /* Keep what the headunit accepted once the learning wizard is done */
+  bool learning = is_learning();
+  if (learning_active && !learning && resistive_driver()) {
+    uint8_t accepted = resistive_driver()->get_accepted_functions();
+    if (config.accepted_functions != accepted) {
+      config.accepted_functions = accepted;
+      config_store.mark_dirty(millis());
     }
+  }
+  learning_active = learning;
+
+  uint32_t now = millis();
+  update_status_led(now);
+  /* Erasing and programming stalls the CPU, which would stretch the marks
+   * and spaces of a frame going out. Commit between commands instead */
+  if (swc_command_queue.is_idle() && !pulse_engine.is_busy()) {
+    config_store.service(now);
+  }
 
-    if (encoder_flags & ENCODER_FLAG_ENCODER_BUTTON_DOUBLE_PRESS_BM) {
-      if (headunit_brand == HEADUNIT_GENERIC_RESISTIVE) {
-        Learning_Mode_State_t state =
-            generic_resistive_swc.get_learning_mode_state();
-        if (state == IDLE) {
-          generic_resistive_swc.on_button_double_press();
-        } else if (state == COMPLETE) {
-          generic_resistive_swc.on_learning_mode_completed();
-          encoder_flags &=
-              ~(ENCODER_FLAG_ENCODER_BUTTON_DOUBLE_PRESS_BM); // Clear the flag
-          digitalWrite(STATUS_LED_PIN, LOW);
-        } else if (state == WAITING) {
-          digitalWrite(STATUS_LED_PIN, !digitalRead(STATUS_LED_PIN));
-          delay(50);
-        }
-      } else {
-        encoder_flags &=
-            ~(ENCODER_FLAG_ENCODER_BUTTON_DOUBLE_PRESS_BM); // Clear the flag
-        digitalWrite(STATUS_LED_PIN, HIGH);
-        on_encoder_button_double_pressed();
-        digitalWrite(STATUS_LED_PIN, LOW);
-      }
-    }
+  /* A pending config commit needs millis() running, so no STOP until then */
+  bool input_pending = !input_event_ring.is_empty();
+  bool output_idle   = swc_command_queue.is_idle() && !learning &&
+                       !config_store.is_dirty();
+  if (input_pending || !output_idle) {
+    power_manager.on_activity(now);
   }
-}
\ No newline at end of file
+  if (!input_pending) {
+    /* Gesture timeouts and commands still going out need the clocks
+     * running, so only WFI then */
+    power_manager.idle(now, !button_gesture.is_pending() && output_idle);
+  }
+}